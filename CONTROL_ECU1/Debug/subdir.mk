@@ -4,31 +4,43 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../adc.c \
 ../buzzer.c \
 ../dc_motor.c \
 ../eeprom.c \
 ../gpio.c \
 ../main.c \
+../pin.c \
+../profiler.c \
+../pwm.c \
 ../timer.c \
 ../twi.c \
 ../uart.c 
 
 OBJS += \
+./adc.o \
 ./buzzer.o \
 ./dc_motor.o \
 ./eeprom.o \
 ./gpio.o \
 ./main.o \
+./pin.o \
+./profiler.o \
+./pwm.o \
 ./timer.o \
 ./twi.o \
 ./uart.o 
 
 C_DEPS += \
+./adc.d \
 ./buzzer.d \
 ./dc_motor.d \
 ./eeprom.d \
 ./gpio.d \
 ./main.d \
+./pin.d \
+./profiler.d \
+./pwm.d \
 ./timer.d \
 ./twi.d \
 ./uart.d 
@@ -38,7 +50,7 @@ C_DEPS += \
 %.o: ../%.c subdir.mk
 	@echo 'Building file: $<'
 	@echo 'Invoking: AVR Compiler'
-	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
+	avr-gcc -Wall -g2 -gstabs -Os -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
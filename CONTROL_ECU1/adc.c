@@ -0,0 +1,66 @@
+/*
+ * adc.c
+ * Description: Source file for the ADC driver
+ *
+ */
+
+#include <avr/io.h> /* To use the ADC Registers */
+#include <avr/interrupt.h> /* For ADC ISR */
+#include "adc.h"
+#include "common_macros.h"
+
+/* Global variable for the call back function */
+static void (*volatile g_adcCallBackPtr)(void) = NULL_PTR;
+
+ISR(ADC_vect)
+{
+	if(g_adcCallBackPtr != NULL_PTR)
+	{
+		(*g_adcCallBackPtr)();
+	}
+}
+
+/*
+ * Description :
+ * Start the conversions of a channel ( 0 to 7 ) at every Timer0 overflow
+ * and enable the conversion complete interrupt.
+ * Timer0 must be running for the conversions to start.
+ */
+void ADC_init(uint8 channel)
+{
+	/* AVCC reference, right adjusted result */
+	ADMUX = (1<<REFS0) | (channel & 0x07);
+
+	/* Every Timer0 overflow starts a conversion */
+	SFIOR = (SFIOR & 0x1F) | ADC_TRIGGER_TIMER0_OVF;
+
+	ADCSRA = (1<<ADEN) | (1<<ADATE) | (1<<ADIE) | ADC_CLOCK;
+}
+
+/*
+ * Description :
+ * Function to set the Call Back Function Address, called from the ADC interrupt after every conversion
+ */
+void ADC_setCallBack(void(*a_ptr)(void))
+{
+	g_adcCallBackPtr = a_ptr;
+}
+
+/*
+ * Description :
+ * Return the result of the last conversion, to be read from the call back.
+ */
+uint16 ADC_readResult(void)
+{
+	return ADCW; /* ADCL then ADCH */
+}
+
+/*
+ * Description :
+ * Stop the conversions and turn the ADC off.
+ */
+void ADC_DeInit(void)
+{
+	ADCSRA = 0;
+	SFIOR &= 0x1F;
+}
@@ -0,0 +1,60 @@
+/*
+ * adc.h
+ * Description: Header file for the ADC driver
+ *
+ * The ADC converts one channel in the background: every conversion is
+ * started by the Timer0 overflow ( the PWM period ) through the auto trigger,
+ * and its result is handed to the call back from the ADC interrupt.
+ * The main loop spends no time on the sampling.
+ */
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Full scale of a 10 bits conversion, the reference is AVCC */
+#define ADC_MAX_VALUE                  1023
+#define ADC_REF_VOLT_MV                5000
+
+/* ADC prescaler bits: F_CPU/8, 1 MHz / 8 = 125 kHz ADC clock, one conversion = 104 us */
+#define ADC_CLOCK                      ((1<<ADPS1) | (1<<ADPS0))
+
+/* Auto trigger source bits: Timer0 overflow */
+#define ADC_TRIGGER_TIMER0_OVF         ((1<<ADTS2))
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Start the conversions of a channel ( 0 to 7 ) at every Timer0 overflow
+ * and enable the conversion complete interrupt.
+ * Timer0 must be running for the conversions to start.
+ */
+void ADC_init(uint8 channel);
+
+/*
+ * Description :
+ * Function to set the Call Back Function Address, called from the ADC interrupt after every conversion
+ */
+void ADC_setCallBack(void(*a_ptr)(void));
+
+/*
+ * Description :
+ * Return the result of the last conversion, to be read from the call back.
+ */
+uint16 ADC_readResult(void);
+
+/*
+ * Description :
+ * Stop the conversions and turn the ADC off.
+ */
+void ADC_DeInit(void);
+
+#endif /* ADC_H_ */
@@ -1,25 +1,152 @@
 /*
- *  buzzer.h
+ *  buzzer.c
  *
- * Description:Header file for buzzer sensor
+ * Description: Source file for the buzzer
  */
 
+#include <avr/io.h> /* To use the Timer2 Registers */
+#include <avr/pgmspace.h> /* To read the patterns from flash */
+#include <avr/interrupt.h> /* For cli() */
 #include "buzzer.h"
 
 #include "gpio.h"
 
+/* One step of a pattern: a tone ( 0 for silence ) held for a number of ticks */
+typedef struct
+{
+	uint8 tone;
+	uint8 duration;
+}Buzzer_StepType;
+
+/* A step with a 0 duration ends the pattern, its tone tells if the pattern starts again */
+#define BUZZER_SILENCE				0
+#define BUZZER_END					0
+#define BUZZER_REPEAT				1
+
+static const Buzzer_StepType g_buzzerChirp[] PROGMEM = {
+	{ BUZZER_TONE(4000), BUZZER_MS(40) },
+	{ BUZZER_END, 0 }
+};
+
+static const Buzzer_StepType g_buzzerSuccess[] PROGMEM = {
+	{ BUZZER_TONE(1000), BUZZER_MS(100) },
+	{ BUZZER_SILENCE,    BUZZER_MS(30) },
+	{ BUZZER_TONE(2000), BUZZER_MS(150) },
+	{ BUZZER_END, 0 }
+};
+
+static const Buzzer_StepType g_buzzerAlarm[] PROGMEM = {
+	{ BUZZER_TONE(1000), BUZZER_MS(250) },
+	{ BUZZER_TONE(2000), BUZZER_MS(250) },
+	{ BUZZER_REPEAT, 0 }
+};
+
+/* Indexed by Buzzer_PatternType */
+static const Buzzer_StepType * const g_buzzerPatterns[] PROGMEM = {
+	g_buzzerChirp, g_buzzerSuccess, g_buzzerAlarm
+};
+
+/* First and current step of the pattern playing, only used while g_buzzerTicksLeft is not 0 */
+static const Buzzer_StepType *g_buzzerPattern;
+static const Buzzer_StepType *g_buzzerStep;
+
+/* Ticks left in the current step, 0 while no pattern is playing */
+static volatile uint8 g_buzzerTicksLeft = 0;
+
+/* Start the tone on OC2, or silence it with BUZZER_SILENCE */
+static void Buzzer_setTone(uint8 tone)
+{
+	if(tone == BUZZER_SILENCE)
+	{
+		TCCR2 = 0; /* Clock stopped and OC2 back to the PORT value ( low ) */
+	}
+	else
+	{
+		/* OCR2 is not double buffered in CTC mode, restart the count so the new top is not missed */
+		TCNT2 = 0;
+		OCR2 = tone;
+		TCCR2 = (1<<WGM21) | (1<<COM20) | BUZZER_TIMER2_CLOCK; /* CTC mode, toggle OC2 on compare match */
+	}
+}
+
+/* Start the step the sequencer points to, at the end of the pattern repeat it or stop */
+static void Buzzer_loadStep(void)
+{
+	uint8 tone = pgm_read_byte(&g_buzzerStep->tone);
+	uint8 duration = pgm_read_byte(&g_buzzerStep->duration);
+
+	if(duration == 0)
+	{
+		if(tone != BUZZER_REPEAT)
+		{
+			Buzzer_setTone(BUZZER_SILENCE);
+			g_buzzerTicksLeft = 0;
+			return;
+		}
+		g_buzzerStep = g_buzzerPattern;
+		tone = pgm_read_byte(&g_buzzerStep->tone);
+		duration = pgm_read_byte(&g_buzzerStep->duration);
+	}
+
+	Buzzer_setTone(tone);
+	g_buzzerTicksLeft = duration;
+}
 
 void Buzzer_Init(void)
 {
-	GPIO_setupPinDirection(BUZZER_PORT_ID, BUZZER_PIN_ID, PIN_OUTPUT);
+	GPIO_WRITE_PIN(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_LOW); /* Held low while OC2 is disconnected */
+	GPIO_SETUP_PIN_DIRECTION(BUZZER_PORT_ID, BUZZER_PIN_ID, PIN_OUTPUT);
+	Buzzer_setTone(BUZZER_SILENCE);
 }
 
 void Buzzer_On(void)
 {
-	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_HIGH);
+	uint8 sreg = SREG;
+
+	cli();
+	g_buzzerTicksLeft = 0; /* A continuous tone, not a pattern */
+	Buzzer_setTone(BUZZER_DEFAULT_TONE);
+	SREG = sreg;
 }
 
 void Buzzer_Off(void)
 {
-	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_LOW);
+	uint8 sreg = SREG;
+
+	cli();
+	g_buzzerTicksLeft = 0;
+	Buzzer_setTone(BUZZER_SILENCE);
+	SREG = sreg;
+}
+
+void Buzzer_play(Buzzer_PatternType pattern)
+{
+	uint8 sreg = SREG;
+
+	/* The tick reads the pattern while g_buzzerTicksLeft is not 0, change them together */
+	cli();
+	g_buzzerPattern = (const Buzzer_StepType *)pgm_read_word(&g_buzzerPatterns[pattern]);
+	g_buzzerStep = g_buzzerPattern;
+	Buzzer_loadStep();
+	SREG = sreg;
+}
+
+boolean Buzzer_isPlaying(void)
+{
+	return (g_buzzerTicksLeft != 0);
+}
+
+void Buzzer_tick(void)
+{
+	if(g_buzzerTicksLeft == 0)
+	{
+		return; /* Idle or continuous tone */
+	}
+
+	g_buzzerTicksLeft--;
+	if(g_buzzerTicksLeft == 0)
+	{
+		g_buzzerStep++;
+		Buzzer_loadStep();
+	}
 }
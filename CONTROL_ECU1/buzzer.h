@@ -1,31 +1,73 @@
 /*
  * buzzer.h
- * Description:source file for buzzer sensor
+ * Description: Header file for the buzzer
+ *
+ * The tone is generated by Timer2 in CTC mode toggling the OC2 pin (PD7),
+ * so a sounding buzzer costs no CPU time. The patterns are played by a
+ * sequencer whose Buzzer_tick() must be called every BUZZER_TICK_US,
+ * normally from the PWM period interrupt ( TIMER0 call back ).
  */
 
 #ifndef BUZZER_H_
 #define BUZZER_H_
 #include"std_types.h"
 
-/*making the buzzer configurable*/
-#define BUZZER_PORT_ID				PORTA_ID
-#define BUZZER_PIN_ID				PIN0_ID
+/* OC2 pin, the output of Timer2 */
+#define BUZZER_PORT_ID				PORTD_ID
+#define BUZZER_PIN_ID				PIN7_ID
+
+/* Timer2 prescaler bits: F_CPU/8, tones from 245 Hz ( OCR2 = 255 ) up */
+#define BUZZER_TIMER2_CLOCK			(1<<CS21)
+#define BUZZER_TIMER2_PRESCALER		8
+
+/* OCR2 value of a tone, the pin toggles at every compare match so one tone period is two matches */
+#define BUZZER_TONE(freq_hz)		((uint8)((F_CPU / (2UL * BUZZER_TIMER2_PRESCALER * (freq_hz))) - 1))
+
+/* Tone of Buzzer_On() */
+#define BUZZER_DEFAULT_TONE			BUZZER_TONE(2000)
+
+/* Period of the sequencer tick, the PWM period of the DC Motor */
+#define BUZZER_TICK_US				2048
+
+/* Step duration in sequencer ticks, at most 522 ms */
+#define BUZZER_MS(ms)				((uint8)(((ms) * 1000UL) / BUZZER_TICK_US))
+
+typedef enum
+{
+	BUZZER_CHIRP, BUZZER_SUCCESS, BUZZER_ALARM
+}Buzzer_PatternType;
 
 
 /*
  * Description :
- * Function responsible for initializing the buzzer
+ * Function responsible for initializing the buzzer, it starts silent
  */
 void Buzzer_Init(void);
 /*
  * Description :
- * Function responsible for turning on the buzzer
+ * Function responsible for turning on the buzzer with a continuous tone
  */
 void Buzzer_On(void);
 /*
  * Description :
- * Function responsible for turning off the buzzer
+ * Function responsible for turning off the buzzer, the pattern playing is stopped too
  */
 void Buzzer_Off(void);
+/*
+ * Description :
+ * Start playing a pattern without waiting, it replaces the one playing.
+ * The alarm repeats until Buzzer_Off(), the other patterns stop by themselves.
+ */
+void Buzzer_play(Buzzer_PatternType pattern);
+/*
+ * Description :
+ * Return TRUE while a pattern is playing
+ */
+boolean Buzzer_isPlaying(void);
+/*
+ * Description :
+ * Sequencer tick, moves the pattern to its next step when the current one is over
+ */
+void Buzzer_tick(void);
 
 #endif /* BUZZER_H_ */
@@ -5,46 +5,196 @@
  *
  */
 
+#include <avr/interrupt.h> /* For cli() */
 #include "dc_motor.h"
 #include "gpio.h"
+#include "pwm.h"
+#include "adc.h"
+
+/* Direction and duty cycle the ramp is heading to */
+static volatile DcMotor_State g_dcMotorTargetState = OFF;
+static volatile uint8 g_dcMotorTargetDuty = 0;
+
+/* Direction on the H-bridge inputs and duty cycle on the enable now */
+static volatile DcMotor_State g_dcMotorState = OFF;
+static volatile uint8 g_dcMotorDuty = 0;
+
+/* Last current samples, their sum and the index of the oldest one */
+static uint16 g_dcMotorSamples[DcMotor_CURRENT_SAMPLES];
+static volatile uint16 g_dcMotorCurrentSum = 0;
+static uint8 g_dcMotorSampleIndex = 0;
+
+/* Set when the motor is stopped for a stall */
+static volatile boolean g_dcMotorStalled = FALSE;
+
+/* Call back of the stall, run from the ADC interrupt */
+static void (*volatile g_dcMotorStallCallBackPtr)(void) = NULL_PTR;
+
+/* Write the direction on both H-bridge inputs in the same register write */
+static void DcMotor_setDirection(DcMotor_State state)
+{
+	if( state == CW )
+	{
+		GPIO_writeMasked(DcMotor_PORT_ID, DcMotor_PINS_MASK, (1<<DcMotor_PIN2));
+	}
+	else if ( state == A_CW )
+	{
+		GPIO_writeMasked(DcMotor_PORT_ID, DcMotor_PINS_MASK, (1<<DcMotor_PIN1));
+	}
+	else
+	{
+		GPIO_writeMasked(DcMotor_PORT_ID, DcMotor_PINS_MASK, 0);
+	}
+	g_dcMotorState = state;
+}
 
 void DcMotor_Init(void)
 {
 
 	 //Configure the two pins of the DC Motor as an output pins
-	GPIO_setupPinDirection(DcMotor_PORT_ID, DcMotor_PIN1, PIN_OUTPUT);
-	GPIO_setupPinDirection(DcMotor_PORT_ID, DcMotor_PIN2, PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(DcMotor_PORT_ID, DcMotor_PIN1, PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(DcMotor_PORT_ID, DcMotor_PIN2, PIN_OUTPUT);
 
 
 	 //Stop the DC Motor at the beginning
-	GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN1, LOGIC_LOW);
-	GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN2, LOGIC_LOW);
+	DcMotor_setDirection(OFF);
+
+	 //The enable pin is driven by the PWM, DcMotor_rampTick() must be called every PWM period
+	PWM_Timer0_Init();
+
+	 //The current is sampled at every PWM period, the conversions are started by the Timer0 overflow
+	ADC_setCallBack(DcMotor_currentSample);
+	ADC_init(DcMotor_SENSE_CHANNEL);
 }
 
 
 void DcMotor_Rotate(DcMotor_State state, uint8 speed)
 {
+	uint8 sreg;
 
+	if( (state != CW) && (state != A_CW) && (state != OFF) )
+	{
+		/* Invalid Input State - Do Nothing */
+		return;
+	}
 
-	 //Check the state and rotate the DC Motor
-	if( state == CW )
+	if( (state == OFF) || (speed == 0) )
 	{
-		GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN1, LOGIC_LOW);
-		GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN2, LOGIC_HIGH);
+		state = OFF;
+		speed = 0;
 	}
-	else if ( state == A_CW )
+	else if( speed > DcMotor_MAX_SPEED )
 	{
-		GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN1, LOGIC_HIGH);
-		GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN2, LOGIC_LOW);
+		speed = DcMotor_MAX_SPEED;
 	}
-	else if ( state == OFF )
+
+	 //The ramp interrupt reads both targets, change them together
+	sreg = SREG;
+	cli();
+	if( state != OFF )
 	{
-		GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN1, LOGIC_LOW);
-		GPIO_writePin(DcMotor_PORT_ID, DcMotor_PIN2, LOGIC_LOW);
+		g_dcMotorStalled = FALSE; /* A new move, the stall of the last one is over */
 	}
-	else
+	g_dcMotorTargetState = state;
+	g_dcMotorTargetDuty = (uint8)(((uint16)speed * PWM_MAX_DUTY) / DcMotor_MAX_SPEED);
+	SREG = sreg;
+}
+
+
+void DcMotor_Stop(void)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_dcMotorTargetState = OFF;
+	g_dcMotorTargetDuty = 0;
+	g_dcMotorDuty = 0;
+	PWM_Timer0_setDutyCycle(0);
+	DcMotor_setDirection(OFF);
+	SREG = sreg;
+}
+
+
+boolean DcMotor_isSettled(void)
+{
+	return (g_dcMotorState == g_dcMotorTargetState) && (g_dcMotorDuty == g_dcMotorTargetDuty);
+}
+
+
+boolean DcMotor_isStalled(void)
+{
+	return g_dcMotorStalled;
+}
+
+
+void DcMotor_setStallCallBack(void(*a_ptr)(void))
+{
+	g_dcMotorStallCallBackPtr = a_ptr;
+}
+
+
+uint16 DcMotor_getCurrent(void)
+{
+	uint16 sum;
+	uint8 sreg = SREG;
+
+	 //The sum is written by the ADC interrupt, take it in one piece
+	cli();
+	sum = g_dcMotorCurrentSum;
+	SREG = sreg;
+
+	return sum / DcMotor_CURRENT_SAMPLES;
+}
+
+
+void DcMotor_currentSample(void)
+{
+	uint16 sample = ADC_readResult();
+
+	 //Moving average: the new sample replaces the oldest one in the running sum
+	g_dcMotorCurrentSum = g_dcMotorCurrentSum - g_dcMotorSamples[g_dcMotorSampleIndex] + sample;
+	g_dcMotorSamples[g_dcMotorSampleIndex] = sample;
+	g_dcMotorSampleIndex = (g_dcMotorSampleIndex + 1) & (DcMotor_CURRENT_SAMPLES - 1);
+
+	 //A stall is only looked for once the ramp reached the cruise speed
+	if( (g_dcMotorState != OFF) && DcMotor_isSettled() &&
+		(g_dcMotorCurrentSum > (uint16)DcMotor_STALL_CURRENT * DcMotor_CURRENT_SAMPLES) )
+	{
+		DcMotor_Stop();
+		g_dcMotorStalled = TRUE;
+		if( g_dcMotorStallCallBackPtr != NULL_PTR )
 		{
-			/* Invalid Input State - Do Nothing */
+			(*g_dcMotorStallCallBackPtr)();
 		}
+	}
+}
 
+
+void DcMotor_rampTick(void)
+{
+	uint8 target_duty = g_dcMotorTargetDuty;
+
+	 //A change of direction goes through stop first
+	if( g_dcMotorState != g_dcMotorTargetState )
+	{
+		if( g_dcMotorDuty == 0 )
+		{
+			DcMotor_setDirection(g_dcMotorTargetState);
+		}
+		else
+		{
+			target_duty = 0;
+		}
+	}
+
+	if( g_dcMotorDuty < target_duty )
+	{
+		g_dcMotorDuty = ( (target_duty - g_dcMotorDuty) > DcMotor_ACCEL_STEP ) ? (g_dcMotorDuty + DcMotor_ACCEL_STEP) : target_duty;
+		PWM_Timer0_setDutyCycle(g_dcMotorDuty);
+	}
+	else if( g_dcMotorDuty > target_duty )
+	{
+		g_dcMotorDuty = ( (g_dcMotorDuty - target_duty) > DcMotor_DECEL_STEP ) ? (g_dcMotorDuty - DcMotor_DECEL_STEP) : target_duty;
+		PWM_Timer0_setDutyCycle(g_dcMotorDuty);
+	}
 }
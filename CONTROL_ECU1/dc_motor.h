@@ -14,6 +14,34 @@
 #define DcMotor_PIN1 		PIN0_ID
 #define DcMotor_PIN2 		PIN1_ID
 
+/* The two H-bridge inputs, always written together in one register write */
+#define DcMotor_PINS_MASK 	((1<<DcMotor_PIN1) | (1<<DcMotor_PIN2))
+
+/* The H-bridge enable is driven by the PWM on OC0 ( PB3 ) */
+
+/*
+ * Acceleration profile: duty cycle steps ( out of 255 ) added or removed every PWM period ( 2.048 ms ).
+ * With 2 a ramp from stop to full speed takes 128 periods = 262 ms.
+ */
+#define DcMotor_ACCEL_STEP 	2
+#define DcMotor_DECEL_STEP 	3
+
+/* Speeds are given in percent */
+#define DcMotor_MAX_SPEED 	100
+
+/*
+ * Motor current sense: the voltage of the H-bridge sense resistor on ADC0 ( PA0 ),
+ * sampled once every PWM period and averaged on the last DcMotor_CURRENT_SAMPLES samples ( 16 ms ).
+ */
+#define DcMotor_SENSE_CHANNEL 		0
+#define DcMotor_CURRENT_SAMPLES 	8 	/* must be a power of two */
+
+/*
+ * Averaged current ( ADC counts ) above which the motor is stalled, it is only checked at the cruise speed
+ * so the current of the soft start is not taken for a stall. 410 counts = 2 V on the sense resistor.
+ */
+#define DcMotor_STALL_CURRENT 		410
+
 
 typedef enum
 {
@@ -30,8 +58,51 @@ void DcMotor_Init(void);
 /*
  * Description :
  * The function responsible for rotate the DC Motor CW/ or A-CW or stop the motor based on the state input state value.
- * Send the required duty cycle to the PWM driver based on the required speed value.
+ * The speed ( 0 to 100 % ) is reached through a ramp run by the PWM period interrupt, the function doesn't wait.
+ * A change of direction first ramps the motor down to stop.
  */
 void DcMotor_Rotate(DcMotor_State state,uint8 speed);
 
+/*
+ * Description :
+ * Stop the DC Motor at once, without the ramp ( emergency stop ).
+ */
+void DcMotor_Stop(void);
+
+/*
+ * Description :
+ * Return TRUE once the ramp reached the required direction and speed.
+ */
+boolean DcMotor_isSettled(void);
+
+/*
+ * Description :
+ * Return TRUE if the motor was stopped because it stalled, cleared by the next DcMotor_Rotate() in a direction.
+ */
+boolean DcMotor_isStalled(void);
+
+/*
+ * Description :
+ * Function to set the Call Back Function Address, called from the ADC interrupt when the motor stalls
+ */
+void DcMotor_setStallCallBack(void(*a_ptr)(void));
+
+/*
+ * Description :
+ * Return the averaged motor current in ADC counts.
+ */
+uint16 DcMotor_getCurrent(void);
+
+/*
+ * Description :
+ * Current sample, the ADC call back: updates the average and stops the motor at once if it stalls.
+ */
+void DcMotor_currentSample(void);
+
+/*
+ * Description :
+ * Ramp tick, must be called every PWM period from the TIMER0 call back of the application.
+ */
+void DcMotor_rampTick(void);
+
 #endif
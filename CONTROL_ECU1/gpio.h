@@ -8,6 +8,8 @@
 #define GPIO_H_
 
 #include "std_types.h"
+#include "common_macros.h" /* To use the macros like SET_BIT */
+#include <avr/io.h> /* To use the IO Ports Registers */
 
 /*******************************************************************************
  *                                Definitions                                  *
@@ -29,6 +31,60 @@
 #define PIN6_ID                6
 #define PIN7_ID                7
 
+/* Pins of the external interrupts */
+#define EXT_INT0_PORT_ID       PORTD_ID
+#define EXT_INT0_PIN_ID        PIN2_ID
+#define EXT_INT1_PORT_ID       PORTD_ID
+#define EXT_INT1_PIN_ID        PIN3_ID
+#define EXT_INT2_PORT_ID       PORTB_ID
+#define EXT_INT2_PIN_ID        PIN2_ID
+
+/*
+ * Compile-time pin access.
+ * These macros take constant port and pin ids and resolve directly to the PORTx, DDRx and PINx registers
+ * so a pin write compiles to one sbi/cbi instruction and a pin read to one sbis/sbic,
+ * without the range checks and the switch on the port number done by the GPIO functions.
+ * The ids are not validated, use the GPIO functions when the port or pin is only known at run time.
+ */
+#define GPIO_CONCAT(a,b)               GPIO_CONCAT_EXPANDED(a,b)
+#define GPIO_CONCAT_EXPANDED(a,b)      a##b
+
+#define GPIO_PORT_REG_0                PORTA
+#define GPIO_PORT_REG_1                PORTB
+#define GPIO_PORT_REG_2                PORTC
+#define GPIO_PORT_REG_3                PORTD
+
+#define GPIO_DDR_REG_0                 DDRA
+#define GPIO_DDR_REG_1                 DDRB
+#define GPIO_DDR_REG_2                 DDRC
+#define GPIO_DDR_REG_3                 DDRD
+
+#define GPIO_PIN_REG_0                 PINA
+#define GPIO_PIN_REG_1                 PINB
+#define GPIO_PIN_REG_2                 PINC
+#define GPIO_PIN_REG_3                 PIND
+
+/* Registers of a constant port id */
+#define GPIO_PORT_REG(port_id)         GPIO_CONCAT(GPIO_PORT_REG_,port_id)
+#define GPIO_DDR_REG(port_id)          GPIO_CONCAT(GPIO_DDR_REG_,port_id)
+#define GPIO_PIN_REG(port_id)          GPIO_CONCAT(GPIO_PIN_REG_,port_id)
+
+/* Compile-time versions of the GPIO functions */
+#define GPIO_SETUP_PIN_DIRECTION(port_id,pin_id,direction) \
+	((void)(((direction) == PIN_OUTPUT) ? SET_BIT(GPIO_DDR_REG(port_id),pin_id) : CLEAR_BIT(GPIO_DDR_REG(port_id),pin_id)))
+
+#define GPIO_WRITE_PIN(port_id,pin_id,value) \
+	((void)(((value) == LOGIC_HIGH) ? SET_BIT(GPIO_PORT_REG(port_id),pin_id) : CLEAR_BIT(GPIO_PORT_REG(port_id),pin_id)))
+
+#define GPIO_READ_PIN(port_id,pin_id) \
+	(BIT_IS_SET(GPIO_PIN_REG(port_id),pin_id) ? LOGIC_HIGH : LOGIC_LOW)
+
+#define GPIO_SETUP_PORT_DIRECTION(port_id,direction)   (GPIO_DDR_REG(port_id) = (direction))
+
+#define GPIO_WRITE_PORT(port_id,value)                 (GPIO_PORT_REG(port_id) = (value))
+
+#define GPIO_READ_PORT(port_id)                        (GPIO_PIN_REG(port_id))
+
 /*******************************************************************************
  *                               Types Declaration                             *
  *******************************************************************************/
@@ -42,6 +98,17 @@ typedef enum
 	PORT_INPUT,PORT_OUTPUT=0xFF
 }GPIO_PortDirectionType;
 
+typedef enum
+{
+	EXT_INT0,EXT_INT1,EXT_INT2
+}GPIO_ExternalInterruptId;
+
+/* Values match the ISCn1:ISCn0 encoding, INT2 only supports the two edges */
+typedef enum
+{
+	INT_LOW_LEVEL,INT_ANY_CHANGE,INT_FALLING_EDGE,INT_RISING_EDGE
+}GPIO_InterruptSenseType;
+
 /*******************************************************************************
  *                              Functions Prototypes                           *
  *******************************************************************************/
@@ -93,4 +160,48 @@ void GPIO_writePort(uint8 port_num, uint8 value);
  */
 uint8 GPIO_readPort(uint8 port_num);
 
+/*
+ * Description :
+ * Write the value bits selected by the mask on the required port in one register write,
+ * the other pins of the port keep their values.
+ * The read-modify-write is done with interrupts disabled so an ISR using the same port can not corrupt it.
+ * If the input port number is not correct, The function will not handle the request.
+ */
+void GPIO_writeMasked(uint8 port_num, uint8 mask, uint8 value);
+
+/*
+ * Description :
+ * Toggle the pins selected by the mask on the required port in one register write.
+ * The read-modify-write is done with interrupts disabled so an ISR using the same port can not corrupt it.
+ * If the input port number is not correct, The function will not handle the request.
+ */
+void GPIO_toggleMasked(uint8 port_num, uint8 mask);
+
+/*
+ * Description :
+ * Setup the required external interrupt (INT0 on PD2, INT1 on PD3, INT2 on PB2):
+ * 1. Configure its pin as input, the internal pull-up can be enabled later by GPIO_writePin.
+ * 2. Select the sense of the interrupt, INT2 only accepts INT_FALLING_EDGE or INT_RISING_EDGE.
+ * 3. Clear any pending request and enable the interrupt.
+ * If the interrupt id or the sense are not correct, The function will not handle the request.
+ *
+ * Interrupt cost: the ISR calls the callback through a pointer so it saves all the call-clobbered
+ * registers, about 90 cycles from the edge to the return (about 90 us at 1 MHz) plus the callback body.
+ * The callback runs with the global interrupts disabled, keep it short.
+ */
+void GPIO_setupExternalInterrupt(GPIO_ExternalInterruptId int_id, GPIO_InterruptSenseType sense);
+
+/*
+ * Description :
+ * Disable the required external interrupt.
+ * If the interrupt id is not correct, The function will not handle the request.
+ */
+void GPIO_disableExternalInterrupt(GPIO_ExternalInterruptId int_id);
+
+/*
+ * Description :
+ * Function to set the Call Back Function Address of the required external interrupt.
+ */
+void GPIO_setExternalInterruptCallBack(void(*a_ptr)(void), GPIO_ExternalInterruptId int_id);
+
 #endif /* GPIO_H_ */
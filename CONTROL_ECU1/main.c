@@ -1,12 +1,15 @@
 /*
  * main.c
  * Description : Source file for CONTROL MCU
- * 				  This unit connected to ( DC Motor / External EEPROM / Buzzer )
+ * 				  This unit connected to ( DC Motor / Motor current sense / External EEPROM / Buzzer )
  * 				  It is responsible of all the actions and decisions inside the System
  */
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include <stddef.h>
 
 #include "main.h"
 #include "eeprom.h"
@@ -15,34 +18,95 @@
 #include "uart.h"
 #include "twi.h"
 #include "timer.h"
+#include "gpio.h"
+#include "profiler.h"
 
-/* Global array to store the password saved in the external EEPROM */
-uint8 g_storedPassword[PASSWORD_LENGTH];
+/* Global array to store the password saved in the external EEPROM, loaded at boot and kept with every save */
+uint8 g_storedPassword[PIN_MAX_BYTES];
 
 /* Global array to store the first password inputed from the user */
-uint8 g_receivedPassword[PASSWORD_LENGTH];
+uint8 g_receivedPassword[PIN_MAX_BYTES];
 
 /* Global array to store the second password inputed from the user */
-uint8 g_confirmPassword[PASSWORD_LENGTH];
+uint8 g_confirmPassword[PIN_MAX_BYTES];
 
 /* Global Variable to store the status of the Password after comparing */
 uint8 g_matchStatus = PASS_MIS_MATCHED;
 
-/* Global Variable to keep track of the seconds counted by the timer */
-uint8 g_tick = 0;
+/* Global Variable set when the EEPROM holds a valid configuration block with a password */
+boolean g_provisioned = FALSE;
+
+/* Global Variable to keep track of the lockout seconds left, counted down by the timer */
+volatile uint16 g_lockoutSeconds = 0;
+
+/* Global Variable set by the timer when the lockout seconds left must be saved */
+volatile uint8 g_lockoutSave = FALSE;
+
+/* Global Variable to keep track of the alarm seconds left */
+volatile uint8 g_alarmSeconds = 0;
+
+/* Global Variable to keep track of the lockouts since the last right password */
+uint8 g_lockoutLevel = 0;
+
+/* State of the door sequence, advanced by the interrupts ( PWM tick, limit switches, stall, Emergency Stop ) */
+volatile CONTROL_DoorState g_doorState = DOOR_IDLE;
+
+/* PWM periods left before the time out of the current door state */
+volatile uint16 g_doorTicks = 0;
+
+/* Times the door may still open again after an obstacle in this sequence */
+uint8 g_doorReopens = 0;
+
+/* Set while the HMI MCU follows the door sequence, and the last DOOR_PHASE it was sent */
+boolean g_doorReport = FALSE;
+uint8 g_doorReportedPhase;
+
+/* Token of the open session, and its PWM periods and operations left ( the session is closed when one of them is 0 ) */
+uint16 g_sessionToken = NO_SESSION;
+boolean g_sessionPending = FALSE; /* The token of the new session goes with the next reply */
+volatile uint16 g_sessionTicks = 0;
+uint8 g_sessionOps = 0;
+
+/* State of the 16 bits LFSR the session tokens are taken from, never 0 */
+uint16 g_sessionSeed = 0xACE1;
 
 /* Global Variable to keep track of how many times the user has inputed the password incorrectly */
 uint8 g_passwordMistakes = 0;
 
+/* PWM periods left before the password being typed is dropped */
+volatile uint16 g_digitTicks = 0;
+
+/* Set when a READY_TO_SEND was already taken, the next command frame is half received */
+boolean g_frameStarted = FALSE;
+
+#if PROF_ENABLE
+/* Timer1 count when the last PIN_STREAM_END came in */
+uint16 g_commitTime;
+#endif
+
 /* Global Variable to keep track of the command sent from the CONTROL MCU through UART */
 uint8 g_command;
 
+/*
+ * Command dispatch table in flash, indexed by ( command - CMD_FIRST ).
+ * A new command only needs its entry here, the other entries stay empty.
+ */
+static const CONTROL_CommandType g_commands[CMD_COUNT] PROGMEM = {
+	[OPEN_DOOR - CMD_FIRST]       = { CONTROL_cmdOpenDoor,       CMD_PAYLOAD_PIN | CMD_NEEDS_AUTH },
+	[CHANGE_PASSWORD - CMD_FIRST] = { CONTROL_cmdChangePassword, CMD_PAYLOAD_PIN | CMD_NEEDS_AUTH },
+	[BOOT_STATUS - CMD_FIRST]     = { CONTROL_cmdBootStatus,     0 },
+	[LOCKOUT_STATUS - CMD_FIRST]  = { CONTROL_cmdLockoutStatus,  0 },
+	[DOOR_STATUS - CMD_FIRST]     = { CONTROL_cmdDoorStatus,     0 },
+	[SESSION - CMD_FIRST]         = { CONTROL_cmdSession,        SESSION_FRAME_LENGTH },
+#if PROF_ENABLE
+	[PROFILE_DUMP - CMD_FIRST]    = { CONTROL_cmdProfileDump,    0 },
+#endif
+};
+
 
 int main(void)
 {
 
-	/* Variable to store the pressed key */
-	uint8 key_option;
 	/* Enable Global Interrupts */
 	SREG  |= ( 1 << 7 );
 
@@ -50,89 +114,234 @@ int main(void)
 	UART_ConfigType UART_Config = {9600, EIGHT_BITS, ONE_STOP_BIT, DISABLED};
 	UART_init(&UART_Config);
 
+#if PROF_ENABLE
+	/* Initialize the hot-path profiler */
+	PROF_init();
+#endif
+
 	/* Initialize TWI with Configuration */
 	TWI_configType TWI_Config = {FAST_MODE_400K, Prescaler_1, TWI_ADDRESS};
 	TWI_init(&TWI_Config);
 
+	/* The PWM period interrupt runs the motor ramp and the buzzer patterns */
+	Timer_setCallBack(CONTROL_tickProcessing, TIMER0);
+
 	/* Initialize DC Motor */
 	DcMotor_Init();
+	DcMotor_setStallCallBack(CONTROL_doorStalled);
 
 	/* Initialize Buzzer */
 	Buzzer_Init();
 
-	/* Save the Password for the first time */
-	CONTROL_newPassword();
+	/* The Emergency Stop button is served by its interrupt instead of being polled */
+	GPIO_writePin(EXT_INT2_PORT_ID, EXT_INT2_PIN_ID, LOGIC_HIGH); /* Enable the internal pull-up */
+	GPIO_setExternalInterruptCallBack(CONTROL_emergencyStop, EMERGENCY_STOP_INT);
+	GPIO_setupExternalInterrupt(EMERGENCY_STOP_INT, INT_FALLING_EDGE);
+
+	/* The door limit switches end the moving phases as soon as they close */
+	GPIO_writePin(DOOR_OPEN_LIMIT_PORT_ID, DOOR_OPEN_LIMIT_PIN_ID, LOGIC_HIGH); /* Enable the internal pull-up */
+	GPIO_writePin(DOOR_CLOSED_LIMIT_PORT_ID, DOOR_CLOSED_LIMIT_PIN_ID, LOGIC_HIGH); /* Enable the internal pull-up */
+	GPIO_setExternalInterruptCallBack(CONTROL_doorOpenLimit, DOOR_OPEN_LIMIT_INT);
+	GPIO_setExternalInterruptCallBack(CONTROL_doorClosedLimit, DOOR_CLOSED_LIMIT_INT);
+	GPIO_setupExternalInterrupt(DOOR_OPEN_LIMIT_INT, INT_FALLING_EDGE);
+	GPIO_setupExternalInterrupt(DOOR_CLOSED_LIMIT_INT, INT_FALLING_EDGE);
+
+	/* Load the stored password, the HMI MCU asks for the setup with BOOT_STATUS only if there is none */
+	g_provisioned = CONTROL_loadConfig();
+
+	/* A reset doesn't end the lockout, it goes on with the time left */
+	CONTROL_loadLockout();
 
 	while(1)
 	{
-		/* Wait until the HMI MCU send the inputed password */
-		while(CONTROL_receiveCommand() != SEND_CHECK_PASSWORD);
-		/* Receive the inputed password and store it */
-		CONTROL_receivePassword(g_receivedPassword);
-		/* Receive the command from the HMI MCU */
-		key_option = CONTROL_receiveCommand();
+		/* Run the next command of the HMI MCU once it starts sending */
+		if(UART_isByteReceived() || g_frameStarted)
+		{
+			CONTROL_dispatchCommand(CONTROL_receiveCommand());
+		}
 
-		/* Depending on the pressed key, Perform some operation */
-		switch (key_option)
+		/* Save the lockout progress asked by the timer */
+		CONTROL_lockoutService();
+
+		/* Show the door sequence on the HMI MCU */
+		CONTROL_doorService();
+	}
+}
+
+void CONTROL_TimerCallBackProcessing(void)
+{
+	/* The alarm only sounds at the start of the lockout */
+	if((g_alarmSeconds != 0) && (--g_alarmSeconds == 0))
+	{
+		Buzzer_Off();
+	}
+
+	if(g_lockoutSeconds != 0)
+	{
+		g_lockoutSeconds--;
+
+		/* Save the time left now and then, and at the end */
+		if((g_lockoutSeconds % LOCKOUT_SAVE_PERIOD) == 0)
 		{
-		case OPEN_DOOR:
+			g_lockoutSave = TRUE;
+		}
+	}
+}
 
-			/* Read Password from the EEPROM */
-			CONTROL_readPassword(g_storedPassword);
-			/* Compare it with the input */
-			g_matchStatus = CONTROL_comparePasswords(g_receivedPassword, g_storedPassword);
 
-			/* In case the two passwords matches */
-			if(g_matchStatus == PASS_MATCHED)
-			{
-				/* Send Opening Door command to HMI MCU */
-				CONTROL_sendCommand(OPENING_DOOR);
-				/* Start Opening Door sequence */
-				CONTROL_openingDoor();
-			}
-			/* In case the two passwords did not match */
-			else if(g_matchStatus == PASS_MIS_MATCHED)
-			{
-				/* Send Wrong Password command to HMI MCU */
-				CONTROL_sendCommand(WRONG_PASSWORD);
-				/* Start Wrong Password sequence */
-				CONTROL_wrongPassword();
-			}
+void CONTROL_tickProcessing(void)
+{
+	DcMotor_rampTick(); /* Soft start and stop of the door motor */
+	Buzzer_tick();      /* Next step of the buzzer pattern */
+	CONTROL_doorTick(); /* Time outs of the door sequence */
+
+	/* Time out of the password being typed */
+	if(g_digitTicks != 0)
+	{
+		g_digitTicks--;
+	}
+
+	/* The session closes by itself once its time is over */
+	if(g_sessionTicks != 0)
+	{
+		g_sessionTicks--;
+	}
+}
 
-			break; /* End of open door case */
 
-		case CHANGE_PASSWORD:
+void CONTROL_emergencyStop(void)
+{
+	DcMotor_Stop(); /* Stop the Motor at once, without the ramp */
+	g_doorState = DOOR_IDLE; /* End the door sequence */
+	g_doorTicks = 0;
+}
 
-			/* Read Password from the EEPROM */
-			CONTROL_readPassword(g_storedPassword);
-			/* Compare it with the inputed user */
-			g_matchStatus = CONTROL_comparePasswords(g_receivedPassword, g_storedPassword);
 
-			/* In case the two passwords matches */
-			if(g_matchStatus == PASS_MATCHED)
-			{
-				/* Send Changing Password command to HMI MCU */
-				CONTROL_sendCommand(CHANGING_PASSWORD);
-				/* Start New Password sequence */
-				CONTROL_newPassword();
-			}
-			/* In case the two passwords did not match */
-			else if(g_matchStatus == PASS_MIS_MATCHED)
-			{
-				/* Send Wrong Password command to HMI MCU */
-				CONTROL_sendCommand(WRONG_PASSWORD);
-				/* Start Wrong Password sequence */
-				CONTROL_wrongPassword();
-			}
+void CONTROL_doorOpenLimit(void)
+{
+	if(g_doorState == DOOR_OPENING)
+	{
+		DcMotor_Stop(); /* End of travel, no ramp */
+		CONTROL_doorEnter(DOOR_HOLD);
+	}
+}
+
 
-			break; /* End of change password case */
+void CONTROL_doorClosedLimit(void)
+{
+	if(g_doorState == DOOR_CLOSING)
+	{
+		DcMotor_Stop(); /* End of travel, no ramp */
+		CONTROL_doorEnter(DOOR_IDLE);
+	}
+}
+
+
+void CONTROL_doorStalled(void)
+{
+	/* The motor is already stopped by the DC Motor driver */
+	if(g_doorState == DOOR_OPENING)
+	{
+		CONTROL_doorEnter(DOOR_HOLD);
+	}
+	else if(g_doorState == DOOR_CLOSING)
+	{
+		if(g_doorReopens != 0)
+		{
+			/* An obstacle in the way of the closing door, open it again and try once more */
+			g_doorReopens--;
+			Buzzer_play(BUZZER_CHIRP);
+			CONTROL_doorEnter(DOOR_OPENING);
+		}
+		else
+		{
+			CONTROL_doorEnter(DOOR_IDLE);
 		}
 	}
 }
 
-void CONTROL_TimerCallBackProcessing(void)
+
+void CONTROL_doorTick(void)
+{
+	if(g_doorState == DOOR_IDLE)
+	{
+		return;
+	}
+
+	g_doorTicks--;
+	if(g_doorTicks != 0)
+	{
+		return;
+	}
+
+	/* Time out of the current state */
+	switch(g_doorState)
+	{
+	case DOOR_OPENING:
+		CONTROL_doorEnter(DOOR_HOLD);
+		break;
+	case DOOR_HOLD:
+		CONTROL_doorEnter(DOOR_CLOSING);
+		break;
+	default:
+		CONTROL_doorEnter(DOOR_IDLE);
+		break;
+	}
+}
+
+
+void CONTROL_doorEnter(CONTROL_DoorState state)
 {
-	g_tick++; /* Increment the counter */
+	/* A limit switch already closed at the start of a phase won't give an edge */
+	if((state == DOOR_OPENING) && (GPIO_READ_PIN(DOOR_OPEN_LIMIT_PORT_ID, DOOR_OPEN_LIMIT_PIN_ID) == DOOR_LIMIT_PRESSED))
+	{
+		state = DOOR_HOLD;
+	}
+	else if((state == DOOR_CLOSING) && (GPIO_READ_PIN(DOOR_CLOSED_LIMIT_PORT_ID, DOOR_CLOSED_LIMIT_PIN_ID) == DOOR_LIMIT_PRESSED))
+	{
+		state = DOOR_IDLE;
+	}
+
+	g_doorState = state;
+
+	switch(state)
+	{
+	case DOOR_OPENING:
+		/*
+		 * Do Open Door Task:
+		 * 					 --> Rotate the DC Motor
+		 * 					 --> Clock Wise
+		 * 					 --> until the open limit switch or a stall, 15 seconds at most
+		 */
+		DcMotor_Rotate(CW,DOOR_CRUISE_SPEED); /* Soft start up to the cruise speed */
+		g_doorTicks = (uint16)OPEN_DOOR_TIME * DOOR_TICKS_PER_SECOND;
+		break;
+
+	case DOOR_HOLD:
+		/*
+		 * Do Hold Task:
+		 * 					 --> Stop the DC Motor for 3 seconds
+		 */
+		DcMotor_Rotate(OFF,0); /* Soft stop, the motor is already stopped if the limit switch was reached */
+		g_doorTicks = (uint16)HOLD_DOOR_TIME * DOOR_TICKS_PER_SECOND;
+		break;
+
+	case DOOR_CLOSING:
+		/*
+		 * Do Close Door Task:
+		 * 					 --> Rotate the DC Motor
+		 * 					 --> Anti Clock Wise
+		 * 					 --> until the closed limit switch or a stall, 15 seconds at most
+		 */
+		DcMotor_Rotate(A_CW,DOOR_CRUISE_SPEED); /* Soft start up to the cruise speed */
+		g_doorTicks = (uint16)CLOSE_DOOR_TIME * DOOR_TICKS_PER_SECOND;
+		break;
+
+	default:
+		DcMotor_Rotate(OFF,0); /* Stop the Motor */
+		g_doorTicks = 0;
+		break;
+	}
 }
 
 
@@ -150,6 +359,383 @@ void CONTROL_startTimer(void)
 
 
 
+void CONTROL_dispatchCommand(uint8 command)
+{
+	uint8 index = (uint8)(command - CMD_FIRST); /* Codes under CMD_FIRST wrap above CMD_COUNT */
+	uint8 info;
+	void (*handler)(void);
+
+	if(index >= CMD_COUNT)
+	{
+		return; /* Not a command */
+	}
+
+	handler = (void (*)(void))pgm_read_word(&g_commands[index].handler);
+	info = pgm_read_byte(&g_commands[index].info);
+
+	if(handler == NULL_PTR)
+	{
+		return; /* No entry for this code */
+	}
+
+	/* Receive the payload, the password buffer holds it */
+	if((info & CMD_PAYLOAD_MASK) == CMD_PAYLOAD_PIN)
+	{
+		/* The digits are checked while the user types, the verdict is ready with the last one */
+		g_matchStatus = CONTROL_receiveDigits(g_storedPassword);
+		if(g_matchStatus == PASS_ABORTED)
+		{
+			return; /* The HMI MCU gave up or was reset, no answer and no mistake counted */
+		}
+	}
+	else
+	{
+		CONTROL_receivePayload(g_receivedPassword, info & CMD_PAYLOAD_MASK);
+	}
+
+	if(info & CMD_NEEDS_AUTH)
+	{
+		/* No password is checked while the lockout runs */
+		if(CONTROL_lockoutSecondsLeft() != 0)
+		{
+			CONTROL_sendCommand(LOCKED_OUT);
+			return;
+		}
+
+		/* In case the two passwords did not match */
+		if(g_matchStatus == PASS_MIS_MATCHED)
+		{
+			/* Start Wrong Password sequence, it answers the HMI MCU */
+			CONTROL_wrongPassword();
+			return;
+		}
+
+		CONTROL_clearMistakes();
+
+		/* The next commands may send the token in place of the password */
+		CONTROL_startSession();
+	}
+
+	(*handler)();
+}
+
+
+void CONTROL_cmdOpenDoor(void)
+{
+	/* Start Opening Door sequence, the motor doesn't wait for the handshake of the answer */
+	CONTROL_openingDoor();
+#if PROF_ENABLE
+	PROF_record(PROF_COMMIT_TO_MOTOR, (uint16)(TCNT1 - g_commitTime));
+#endif
+	/* Send Opening Door command to HMI MCU, its screens follow the DOOR_STATUS frames from now on */
+	CONTROL_sendReply(OPENING_DOOR);
+	g_doorReportedPhase = DOOR_PHASE_NONE; /* The first phase is always sent, even if the door is idle again */
+	g_doorReport = TRUE;
+}
+
+
+void CONTROL_cmdChangePassword(void)
+{
+	/* The session stood for the old password */
+	CONTROL_endSession();
+
+	/* Send Changing Password command to HMI MCU */
+	CONTROL_sendReply(CHANGING_PASSWORD);
+	/* Start New Password sequence */
+	CONTROL_newPassword();
+}
+
+
+void CONTROL_cmdBootStatus(void)
+{
+	/* A reset HMI MCU no longer shows the door screens */
+	g_doorReport = FALSE;
+
+	if(g_provisioned)
+	{
+		CONTROL_sendCommand(PROVISIONED);
+	}
+	else
+	{
+		CONTROL_sendCommand(NOT_PROVISIONED);
+		/* Save the Password for the first time */
+		CONTROL_newPassword();
+	}
+}
+
+
+void CONTROL_cmdLockoutStatus(void)
+{
+	uint16 seconds = CONTROL_lockoutSecondsLeft();
+	uint16 length = CONTROL_lockoutLength();
+
+	CONTROL_sendCommand((uint8)(seconds >> 8));
+	CONTROL_sendCommand((uint8)seconds);
+	CONTROL_sendCommand((uint8)(length >> 8));
+	CONTROL_sendCommand((uint8)length);
+}
+
+
+void CONTROL_cmdDoorStatus(void)
+{
+	/* The door sequence runs from the interrupts, its state can be asked at any time */
+	CONTROL_sendCommand(CONTROL_doorPhase());
+}
+
+
+void CONTROL_cmdSession(void)
+{
+	uint16 token = ((uint16)g_receivedPassword[0] << 8) | g_receivedPassword[1];
+	uint8 index = (uint8)(g_receivedPassword[2] - CMD_FIRST);
+	void (*handler)(void);
+
+	/* Only a command that needs the password may come in a session, the others are sent on their own */
+	if((index >= CMD_COUNT) || !(pgm_read_byte(&g_commands[index].info) & CMD_NEEDS_AUTH) ||
+		!CONTROL_useSession(token))
+	{
+		/* Tell the HMI MCU to ask for the password */
+		CONTROL_sendCommand(SESSION);
+		CONTROL_sendCommand((uint8)(NO_SESSION >> 8));
+		CONTROL_sendCommand((uint8)NO_SESSION);
+		return;
+	}
+
+	handler = (void (*)(void))pgm_read_word(&g_commands[index].handler);
+	(*handler)();
+}
+
+
+#if PROF_ENABLE
+void CONTROL_cmdProfileDump(void)
+{
+	/* Answer the profiler dump request of the HMI MCU then skip the HMI MCU table */
+	PROF_dump();
+	PROF_discardFrame();
+}
+#endif
+
+
+
+void CONTROL_startSession(void)
+{
+	uint8 steps = TCNT0 | 1; /* The time the password came in, in the PWM period, is not known in advance */
+	uint8 sreg = SREG;
+
+	/* Step the LFSR a number of times given by the PWM counter, the token is its new state */
+	do
+	{
+		g_sessionSeed = (g_sessionSeed >> 1) ^ ((g_sessionSeed & 1) ? 0xB400 : 0);
+	} while(--steps);
+	g_sessionToken = g_sessionSeed;
+	g_sessionOps = SESSION_MAX_OPS;
+
+	cli();
+	g_sessionTicks = (uint16)SESSION_TIME * DOOR_TICKS_PER_SECOND;
+	SREG = sreg;
+
+	/* Sent by CONTROL_sendReply, after the command handler started its work */
+	g_sessionPending = TRUE;
+}
+
+
+void CONTROL_sendReply(uint8 reply)
+{
+	if(g_sessionPending)
+	{
+		g_sessionPending = FALSE;
+		CONTROL_sendCommand(SESSION);
+		CONTROL_sendCommand((uint8)(g_sessionToken >> 8));
+		CONTROL_sendCommand((uint8)g_sessionToken);
+	}
+
+	CONTROL_sendCommand(reply);
+}
+
+
+boolean CONTROL_useSession(uint16 token)
+{
+	uint16 ticks;
+	uint8 sreg = SREG;
+
+	cli();
+	ticks = g_sessionTicks;
+	SREG = sreg;
+
+	if((ticks == 0) || (g_sessionOps == 0) || (token != g_sessionToken))
+	{
+		return FALSE;
+	}
+
+	g_sessionOps--;
+	return TRUE;
+}
+
+
+void CONTROL_endSession(void)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_sessionTicks = 0;
+	SREG = sreg;
+	g_sessionOps = 0;
+	g_sessionToken = NO_SESSION;
+	g_sessionPending = FALSE;
+}
+
+
+uint8 CONTROL_doorPhase(void)
+{
+	CONTROL_DoorState state;
+	uint16 ticks;
+	uint8 sreg = SREG;
+
+	/* Both are moved by the interrupts, take them together */
+	cli();
+	state = g_doorState;
+	ticks = g_doorTicks;
+	SREG = sreg;
+
+	if(state == DOOR_IDLE)
+	{
+		return DOOR_PHASE(DOOR_IDLE, 0);
+	}
+	return DOOR_PHASE(state, (ticks + DOOR_TICKS_PER_SECOND - 1) / DOOR_TICKS_PER_SECOND);
+}
+
+
+void CONTROL_doorService(void)
+{
+	uint8 phase;
+
+	if(!g_doorReport)
+	{
+		return;
+	}
+
+	/* A phase cut short by a limit switch or a stall is sent as soon as it changes */
+	phase = CONTROL_doorPhase();
+	if(phase == g_doorReportedPhase)
+	{
+		return;
+	}
+
+	/* The HMI MCU may start a frame of its own meanwhile ( a reset one sends BOOT_STATUS ), it goes first */
+	if(!CONTROL_pushCommand(DOOR_STATUS) || !CONTROL_pushCommand(phase))
+	{
+		g_doorReport = FALSE;
+		return;
+	}
+	g_doorReportedPhase = phase;
+
+	/* The idle frame ends the door screens */
+	if((phase >> DOOR_PHASE_STATE_SHIFT) == DOOR_IDLE)
+	{
+		g_doorReport = FALSE;
+	}
+}
+
+
+uint16 CONTROL_lockoutSecondsLeft(void)
+{
+	uint16 seconds;
+	uint8 sreg = SREG;
+
+	/* Counted down by the timer interrupt, take it in one piece */
+	cli();
+	seconds = g_lockoutSeconds;
+	SREG = sreg;
+
+	return seconds;
+}
+
+
+uint16 CONTROL_lockoutLength(void)
+{
+	/* The level stops one past LOCKOUT_MAX_LEVEL, so the longest lockout is still known after a reset */
+	if(g_lockoutLevel == 0)
+	{
+		return 0;
+	}
+	return (uint16)WARNING_TIME << (g_lockoutLevel - 1);
+}
+
+
+void CONTROL_loadLockout(void)
+{
+	CONTROL_LockoutType lockout;
+	uint8 *bytes = (uint8 *)&lockout;
+
+	if(CONTROL_readEeprom(LOCKOUT_ADDRESS, bytes, sizeof(CONTROL_LockoutType)) == ERROR)
+	{
+		return;
+	}
+
+	/* A blank or torn record is taken as no mistakes */
+	if(lockout.crc != CONTROL_configCrc(bytes, offsetof(CONTROL_LockoutType, crc)))
+	{
+		return;
+	}
+
+	g_passwordMistakes = lockout.mistakes;
+	g_lockoutLevel = lockout.level;
+	if(lockout.seconds != 0)
+	{
+		g_lockoutSeconds = lockout.seconds; /* The timer is not running yet */
+		CONTROL_startTimer();
+	}
+}
+
+
+void CONTROL_saveLockout(void)
+{
+	CONTROL_LockoutType lockout;
+	uint8 *bytes = (uint8 *)&lockout;
+	uint8 counter; /* Variable to work as a counter */
+
+	lockout.mistakes = g_passwordMistakes;
+	lockout.level = g_lockoutLevel;
+	lockout.seconds = CONTROL_lockoutSecondsLeft();
+	lockout.crc = CONTROL_configCrc(bytes, offsetof(CONTROL_LockoutType, crc));
+
+	/* Loop on the record elements */
+	for( counter = 0; counter < sizeof(CONTROL_LockoutType); counter++)
+	{
+		EEPROM_writeByte( (LOCKOUT_ADDRESS+counter), bytes[counter]);
+		/* Delay for the time gap for storing data in EEPROM */
+		_delay_ms(STORING_TIME);
+	}
+}
+
+
+void CONTROL_lockoutService(void)
+{
+	if(g_lockoutSave == FALSE)
+	{
+		return;
+	}
+	g_lockoutSave = FALSE;
+
+	if(CONTROL_lockoutSecondsLeft() == 0)
+	{
+		Timer_DeInit(TIMER1); /* End of the lockout, stop the timer */
+	}
+
+	CONTROL_saveLockout();
+}
+
+
+void CONTROL_clearMistakes(void)
+{
+	if((g_passwordMistakes != 0) || (g_lockoutLevel != 0))
+	{
+		g_passwordMistakes = 0;
+		g_lockoutLevel = 0;
+		g_lockoutSave = TRUE; /* Saved from the main loop, the command doesn't wait for the EEPROM */
+	}
+}
+
+
 void CONTROL_newPassword(void)
 {
 	/* Set its status at first as mis-matched */
@@ -168,8 +754,12 @@ void CONTROL_newPassword(void)
 		/* Receive the first password from HMI MCU */
 		CONTROL_receivePassword(g_confirmPassword);
 
-		/* Compare the Two received passwords */
+		/* Compare the Two received passwords, a PIN of a wrong length or with a non digit is never saved */
 		g_matchStatus = CONTROL_comparePasswords(g_receivedPassword, g_confirmPassword);
+		if(!PIN_isValid(g_receivedPassword))
+		{
+			g_matchStatus = PASS_MIS_MATCHED;
+		}
 
 		/* In case the Two Passwords did not match */
 		if( g_matchStatus == PASS_MIS_MATCHED )
@@ -189,130 +779,282 @@ void CONTROL_newPassword(void)
 
 
 
-void CONTROL_receivePassword(uint8 a_Password[])
+void CONTROL_receivePayload(uint8 a_payload[], uint8 length)
 {
 	uint8 counter; /* Variable to work as a counter */
 
-	/* Loop on the passwords elements */
-	for( counter = 0; counter < PASSWORD_LENGTH; counter++)
+	/* Loop on the payload elements */
+	for( counter = 0; counter < length; counter++)
 	{
-		a_Password[counter] = UART_recieveByte(); /* Receive Password from HMI MCU */
+		a_payload[counter] = UART_recieveByte(); /* Receive the payload from HMI MCU */
 		_delay_ms(SEND_RECEIVE_TIME);      /* Delay for the time gap for sending receiving time between the MCUs */
 	}
 }
 
+void CONTROL_receivePassword(uint8 a_Password[])
+{
+	/* The first byte holds the length nibble, it gives the number of bytes that follow */
+	CONTROL_receivePayload(a_Password, 1);
+	CONTROL_receivePayload(&a_Password[1], PIN_SIZE_OF(a_Password[0]) - 1); /* Receive Password from HMI MCU */
+}
+
 uint8 CONTROL_comparePasswords(uint8 a_password1[], uint8 a_password2[])
 {
 	uint8 counter; /* Variable to work as a counter */
+	uint8 size = PIN_getSize(a_password1);
+	uint8 difference = 0;
 
-	/* Loop on the passwords elements */
-	for( counter = 0; counter < PASSWORD_LENGTH; counter++)
+	/* Compared in the packed form: the first byte holds the length, so PINs of different lengths differ there */
+	for( counter = 0; counter < size; counter++)
 	{
-		if (a_password1[counter] != a_password2[counter])
-		{
-			return PASS_MIS_MATCHED; /* Return passwords has not matched of one element mis-matched */
-		} /* End if */
+		difference |= a_password1[counter] ^ a_password2[counter]; /* No early exit on a mis-match */
 	} /* End for */
 
-	return PASS_MATCHED; /* Return passwords matches if known of their elements mis-match */
+	return (difference == 0) ? PASS_MATCHED : PASS_MIS_MATCHED;
 }
 
 
-void CONTROL_savePassword(uint8 a_receivedPassword[])
+uint8 CONTROL_receiveDigits(const uint8 a_storedPassword[])
+{
+	uint8 counter = 0; /* Digits received */
+	uint8 digit;
+	uint8 difference = 0;
+	uint16 ticks;
+	uint8 sreg;
+
+	while(1)
+	{
+		sreg = SREG;
+		cli();
+		g_digitTicks = (uint16)DIGIT_TIMEOUT * DOOR_TICKS_PER_SECOND;
+		SREG = sreg;
+
+		/*
+		 * Only the time out is checked while the user types: the lockout save and the door frames block
+		 * without reading the UART, they wait for the main loop after the command
+		 */
+		while(!UART_isByteReceived())
+		{
+			sreg = SREG;
+			cli();
+			ticks = g_digitTicks;
+			SREG = sreg;
+			if(ticks == 0)
+			{
+				return PASS_ABORTED;
+			}
+		}
+
+		digit = UART_recieveByte();
+		if(digit == PIN_STREAM_END)
+		{
+			break;
+		}
+		if(digit > 9)
+		{
+			/* A reset HMI MCU starts a new command frame, its READY_TO_SEND is already taken */
+			g_frameStarted = (digit == READY_TO_SEND);
+			return PASS_ABORTED;
+		}
+
+		/* The same work for every digit: a digit past the stored length meets the pad or a stale nibble */
+		difference |= digit ^ PIN_getDigit(a_storedPassword, (counter < PIN_MAX_DIGITS) ? counter : (PIN_MAX_DIGITS - 1));
+		if(counter < PIN_MAX_DIGITS)
+		{
+			counter++;
+		}
+		else
+		{
+			difference |= 1; /* More digits than a PIN may have */
+		}
+	}
+#if PROF_ENABLE
+	g_commitTime = TCNT1;
+#endif
+
+	difference |= counter ^ PIN_getLength(a_storedPassword);
+
+	return (difference == 0) ? PASS_MATCHED : PASS_MIS_MATCHED;
+}
+
+
+uint8 CONTROL_configCrc(const uint8 *a_data, uint8 length)
+{
+	uint8 crc = 0;
+
+	while(length--)
+	{
+		crc = _crc8_ccitt_update(crc, *a_data++);
+	}
+	return crc;
+}
+
+
+uint8 CONTROL_readEeprom(uint16 address, uint8 a_data[], uint8 length)
 {
 	uint8 counter; /* Variable to work as a counter */
 
-	/* Loop on the passwords elements */
-	for( counter = 0; counter < PASSWORD_LENGTH; counter++)
+	/* A read doesn't wait for a write cycle, the bytes are read without the storing delay */
+	for( counter = 0; counter < length; counter++)
 	{
-		/* Save each element of the password in external EEPROM */
-		EEPROM_writeByte( (0x0311+counter), a_receivedPassword[counter]);
-		/* Delay for the time gap for storing data in EEPROM */
-		_delay_ms(STORING_TIME);
+		PROF_BEGIN(PROF_EEPROM_READ_BYTE);
+		uint8 status = EEPROM_readByte( (address+counter), &a_data[counter]);
+		PROF_END(PROF_EEPROM_READ_BYTE);
+		if(status == ERROR)
+		{
+			return ERROR;
+		}
 	}
+	return SUCCESS;
 }
 
 
-void CONTROL_readPassword(uint8 a_storedPassword[])
+boolean CONTROL_loadConfig(void)
 {
+	CONTROL_ConfigType config;
 	uint8 counter; /* Variable to work as a counter */
+	uint8 pin_end;
 
-	/* Loop on the passwords elements */
-	for( counter = 0; counter < PASSWORD_LENGTH; counter++)
+	/* Magic, version and the first PIN byte, which gives the size of the PIN */
+	if(CONTROL_readEeprom(CONFIG_ADDRESS, (uint8 *)&config, offsetof(CONTROL_ConfigType, password) + 1) == ERROR)
 	{
-		/* Read each element of the password in external EEPROM */
-		EEPROM_readByte( (0x0311+counter), &a_storedPassword[counter]);
-		/* Delay for the time gap for storing data in EEPROM */
-		_delay_ms(STORING_TIME);
+		return FALSE;
+	}
+	pin_end = offsetof(CONTROL_ConfigType, password) + PIN_getSize(config.password);
+
+	/* The rest of the PIN then the CRC, the bytes after the PIN are not used */
+	if((CONTROL_readEeprom(CONFIG_ADDRESS + offsetof(CONTROL_ConfigType, password) + 1, &config.password[1],
+			PIN_getSize(config.password) - 1) == ERROR) ||
+		(CONTROL_readEeprom(CONFIG_ADDRESS + offsetof(CONTROL_ConfigType, crc), &config.crc, 1) == ERROR))
+	{
+		return FALSE;
+	}
+
+	/* A blank EEPROM, an older layout or a block cut by a reset while being written are all rejected */
+	if((config.magic != CONFIG_MAGIC) || (config.version != CONFIG_VERSION) ||
+			(config.crc != CONTROL_configCrc((uint8 *)&config, pin_end)) || !PIN_isValid(config.password))
+	{
+		return FALSE;
+	}
+
+	/* The password is checked from SRAM, the EEPROM is only read again after a reset */
+	for( counter = 0; counter < PIN_getSize(config.password); counter++)
+	{
+		g_storedPassword[counter] = config.password[counter];
 	}
+	return TRUE;
 }
 
-void CONTROL_openingDoor(void)
+
+void CONTROL_savePassword(uint8 a_receivedPassword[])
 {
-	CONTROL_startTimer(); /* Start the Timer */
+	CONTROL_ConfigType config;
+	uint8 *bytes = (uint8 *)&config;
+	uint8 counter; /* Variable to work as a counter */
+	uint8 pin_end = offsetof(CONTROL_ConfigType, password) + PIN_getSize(a_receivedPassword);
+	uint8 status = SUCCESS;
 
-	/*
-	 * Do Open Door Task:
-	 * 					 --> Rotate the DC Motor
-	 * 					 --> Clock Wise
-	 * 					 --> 15 seconds
-	 */
-	DcMotor_Rotate(CW,100);
-	while(g_tick != OPEN_DOOR_TIME); /* Count up to 15 */
-    g_tick = 0; /* Reset counter to reuse it */
+	config.magic = CONFIG_MAGIC;
+	config.version = CONFIG_VERSION;
+	for( counter = 0; counter < PIN_getSize(a_receivedPassword); counter++)
+	{
+		config.password[counter] = a_receivedPassword[counter];
+	}
+	config.crc = CONTROL_configCrc(bytes, pin_end);
 
-	/*
-	 * Do Hold Task:
-	 * 					 --> Stop the DC Motor
-	 */
-    DcMotor_Rotate(OFF,0);
-	while(g_tick != HOLD_DOOR_TIME); /* Count up to 15 */
-    g_tick = 0; /* Reset counter to reuse it */
+	/* Loop on the used elements of the block, the PIN then its CRC */
+	for( counter = 0; counter <= pin_end; counter++)
+	{
+		uint8 offset = (counter < pin_end) ? counter : offsetof(CONTROL_ConfigType, crc);
 
-	/*
-	 * Do Close Door Task:
-	 * 					 --> Rotate the DC Motor
-	 * 					 --> Anti Clock Wise
-	 * 					 --> 15 seconds
-	 */
-    DcMotor_Rotate(A_CW,100);
-	while(g_tick != CLOSE_DOOR_TIME); /* Count up to 15 */
-    g_tick = 0; /* Reset counter to reuse it */
+		/* Save each element of the block in external EEPROM */
+		PROF_BEGIN(PROF_EEPROM_WRITE_BYTE);
+		if(EEPROM_writeByte( (CONFIG_ADDRESS+offset), bytes[offset]) == ERROR)
+		{
+			status = ERROR;
+		}
+		PROF_END(PROF_EEPROM_WRITE_BYTE);
+		/* Delay for the time gap for storing data in EEPROM */
+		_delay_ms(STORING_TIME);
+	}
 
-    DcMotor_Rotate(OFF,0); /* Stop the Motor */
+	/* Checked from SRAM from now on, the previous password stays if the block could not be written */
+	if(status == SUCCESS)
+	{
+		for( counter = 0; counter < PIN_getSize(a_receivedPassword); counter++)
+		{
+			g_storedPassword[counter] = config.password[counter];
+		}
+	}
+	g_provisioned = (status == SUCCESS);
+}
+
+
+
+void CONTROL_openingDoor(void)
+{
+	uint8 sreg = SREG;
 
-    Timer_DeInit(TIMER1); /* Stop the timer */
+	/* The door interrupts move the state machine too, start it with them masked */
+	cli();
+	if(g_doorState == DOOR_IDLE)
+	{
+		g_doorReopens = DOOR_STALL_REOPENS;
+		Buzzer_play(BUZZER_SUCCESS); /* Password accepted */
+		CONTROL_doorEnter(DOOR_OPENING);
+	}
+	SREG = sreg;
 }
 
 
 
 void CONTROL_wrongPassword(void)
 {
+	uint8 sreg;
+
 	g_passwordMistakes++; /* Increment the wrong counter */
 
 	/* If the user entered the password 3 times wrong */
-	if(g_passwordMistakes == MAX_NUM_OF_MISTAKES)
+	if(g_passwordMistakes >= MAX_NUM_OF_MISTAKES)
 	{
-		CONTROL_startTimer(); /* Start the timer to measure time period */
-
-		Buzzer_On(); /* Turn on the buzzer */
-		while(g_tick != WARNING_TIME); /* Count up to 15 */
+		g_passwordMistakes = 0; /* The user gets 3 new tries after the lockout */
 
-		/* Reset the counters */
-		g_tick = 0;
-		g_passwordMistakes = 0;
-
-
-		Timer_DeInit(TIMER1); /* Stop the timer */
+		/* Every lockout since the last right password doubles the time */
+		if(g_lockoutLevel <= LOCKOUT_MAX_LEVEL)
+		{
+			g_lockoutLevel++;
+		}
+		sreg = SREG;
+		cli();
+		g_lockoutSeconds = CONTROL_lockoutLength();
+		g_alarmSeconds = WARNING_TIME;
+		SREG = sreg;
+
+		/* Saved before the answer, a reset right after it can't skip the lockout */
+		CONTROL_saveLockout();
+		CONTROL_startTimer(); /* The timer interrupt counts the lockout down, nothing waits here */
+		Buzzer_play(BUZZER_ALARM); /* The alarm is played by Timer2 and the PWM tick, no CPU time here */
+
+		/* Send Locked Out command to HMI MCU */
+		CONTROL_sendCommand(LOCKED_OUT);
 	}
+	else
+	{
+		/* Saved before the answer, a reset right after it can't clear the mistake */
+		CONTROL_saveLockout();
+		Buzzer_play(BUZZER_CHIRP); /* Short warning, it stops by itself */
 
-	Buzzer_Off(); /* Turn off the buzzer */
+		/* Send Wrong Password command to HMI MCU */
+		CONTROL_sendCommand(WRONG_PASSWORD);
+	}
 }
 
 
 
 void CONTROL_sendCommand(uint8 g_command)
 {
+	PROF_BEGIN(PROF_SEND_COMMAND);
+
 	/* Inform HMI MCU that you are to send */
 	UART_sendByte(READY_TO_SEND);
 
@@ -324,14 +1066,65 @@ void CONTROL_sendCommand(uint8 g_command)
 
 	/* Wait until the HMI MCU receive the command */
 	while(UART_recieveByte() != RECEIVE_DONE);
+
+	PROF_END(PROF_SEND_COMMAND);
 } /* End CONTROL_sendCommand Function */
 
 
 
+boolean CONTROL_pushCommand(uint8 g_command)
+{
+	uint8 answer;
+
+	PROF_BEGIN(PROF_SEND_COMMAND);
+
+	/* Inform HMI MCU that you are to send */
+	UART_sendByte(READY_TO_SEND);
+
+	/* Wait until HMI MCU are ready to receive, or until it starts a frame of its own */
+	do
+	{
+		answer = UART_recieveByte();
+	} while((answer != READY_TO_RECEIVE) && (answer != READY_TO_SEND));
+
+	if(answer == READY_TO_SEND)
+	{
+		/* The HMI MCU doesn't wait for this frame, its own frame is received next */
+		g_frameStarted = TRUE;
+		return FALSE;
+	}
+
+	/* Send the required command to the HMI MCU */
+	UART_sendByte(g_command);
+
+	/* Wait until the HMI MCU receive the command, a reset in between shows as its next frame */
+	do
+	{
+		answer = UART_recieveByte();
+	} while((answer != RECEIVE_DONE) && (answer != READY_TO_SEND));
+
+	if(answer == READY_TO_SEND)
+	{
+		g_frameStarted = TRUE;
+		return FALSE;
+	}
+
+	PROF_END(PROF_SEND_COMMAND);
+	return TRUE;
+}
+
+
+
 uint8 CONTROL_receiveCommand(void)
 {
-	/* Wait until the HMI MCU is ready to send */
-	while(UART_recieveByte() != READY_TO_SEND);
+	PROF_BEGIN(PROF_RECEIVE_COMMAND);
+
+	/* Wait until the HMI MCU is ready to send, unless its READY_TO_SEND was already taken */
+	if(!g_frameStarted)
+	{
+		while(UART_recieveByte() != READY_TO_SEND);
+	}
+	g_frameStarted = FALSE;
 
 	/* Inform the HMI MCU that you are ready to receive */
 	UART_sendByte(READY_TO_RECEIVE);
@@ -342,6 +1135,8 @@ uint8 CONTROL_receiveCommand(void)
 	/* Inform the HMI MCU that the receive has been done successfully */
 	UART_sendByte(RECEIVE_DONE);
 
+	PROF_END(PROF_RECEIVE_COMMAND);
+
 	return g_command; /* Return the command value */
 }
 
@@ -6,40 +6,144 @@
 #define MAIN_H_
 
 #include "std_types.h"
+#include "pin.h"
 
 #define OPENING_DOOR          			0xF0
 #define WRONG_PASSWORD        			0xF1
 #define CHANGING_PASSWORD     			0xF2
-#define OPEN_DOOR             			'+'
-#define CHANGE_PASSWORD       			'-'
 #define READY_TO_SEND         			0xF3
 #define READY_TO_RECEIVE      			0xF4
 #define RECEIVE_DONE          			0xF5
 #define SEND_FIRST_PASSWORD   			0xF6
 #define SEND_SECOND_PASSWORD 			0xF7
-#define SEND_CHECK_PASSWORD   			0xF8
+#define LOCKOUT_STATUS        			0xF8	/* Answered with the lockout seconds left then the whole lockout time, high bytes first */
+#define PROFILE_DUMP          			0xF9
+#define DOOR_STATUS           			0xFA	/* Answered with the DOOR_PHASE of the door sequence, also sent unasked while it runs */
+#define OPEN_DOOR             			0xFB	/* Followed by the password */
+#define CHANGE_PASSWORD       			0xFC	/* Followed by the password */
+#define BOOT_STATUS           			0xFD	/* Answered with PROVISIONED or NOT_PROVISIONED */
+#define LOCKED_OUT            			0xFE	/* Answer to a password sent while the lockout runs */
+#define SESSION               			0xFF	/* Followed by the session token and a command needing the password */
+
+/* Definitions for the command dispatch: the commands are the codes CMD_FIRST to 0xFF */
+#define CMD_FIRST             			0xF0
+#define CMD_COUNT             			16
+#define CMD_PAYLOAD_MASK      			0x7F	/* Bytes received after the command */
+#define CMD_NEEDS_AUTH        			0x80	/* The payload is a password that must match the stored one */
+#define CMD_PAYLOAD_PIN       			0x7F	/* The payload is a PIN sent digit by digit as it is typed, then PIN_STREAM_END */
 
 /* Definitions for Password */
-#define PASSWORD_LENGTH         		5
 #define MAX_NUM_OF_MISTAKES     		3
 #define PASS_MIS_MATCHED              	0
 #define PASS_MATCHED				  	1
+#define PASS_ABORTED              		2	/* The digits stopped coming, or a byte that is not a digit came */
+
+/* Seconds the CONTROL MCU waits for the next digit of a password before it drops the command */
+#define DIGIT_TIMEOUT           		30
+
+/*
+ * Definitions for the session: a right password opens it, CONTROL MCU sends SESSION then the token.
+ * The token stands for the password in SESSION_MAX_OPS commands during SESSION_TIME,
+ * a SESSION frame it refuses is answered with SESSION then NO_SESSION.
+ */
+#define NO_SESSION              		0x0000
+#define SESSION_TIME            		30	/* Seconds */
+#define SESSION_MAX_OPS         		3
+#define SESSION_FRAME_LENGTH    		3	/* Token high byte, token low byte, command */
+
+/* Answers of BOOT_STATUS, the password setup is only run when NOT_PROVISIONED */
+#define NOT_PROVISIONED         		0
+#define PROVISIONED             		1
+
+/* Definitions for the lockout: it doubles at every new lockout up to WARNING_TIME << LOCKOUT_MAX_LEVEL ( 16 minutes ) */
+#define LOCKOUT_MAX_LEVEL       		4
+#define LOCKOUT_SAVE_PERIOD     		10	/* Seconds between two saves of the lockout time left */
+#define LOCKOUT_ADDRESS         		0x0320
+
+/* Definitions for the configuration block in the external EEPROM */
+#define CONFIG_ADDRESS          		0x0300
+#define CONFIG_MAGIC            		0xA5	/* Written once the password was set up */
+#define CONFIG_VERSION          		2	/* 2: the password is a packed PIN */
 
 /* Definitions for Time Periods */
 #define SEND_RECEIVE_TIME      			10
-#define OPEN_DOOR_TIME      			15
+#define OPEN_DOOR_TIME      			15	/* Safety net, the open limit switch normally ends the phase first */
 #define HOLD_DOOR_TIME       			3
-#define CLOSE_DOOR_TIME      			15
-#define WARNING_TIME           			60
+#define CLOSE_DOOR_TIME      			15	/* Safety net, the closed limit switch normally ends the phase first */
+#define WARNING_TIME           			60	/* First lockout, and the alarm of every lockout */
 #define STORING_TIME           			80
 
+/*
+ * Phase of the door sequence in one byte: the CONTROL_DoorState, then the seconds left before its time out.
+ * The phase times must stay under 63 seconds so DOOR_PHASE_NONE is never a phase.
+ */
+#define DOOR_PHASE_STATE_SHIFT 			6
+#define DOOR_PHASE_SECONDS_MASK			0x3F
+#define DOOR_PHASE(state, seconds)		((uint8)(((state) << DOOR_PHASE_STATE_SHIFT) | (seconds)))
+#define DOOR_PHASE_NONE        			0xFF
+
+/* PWM periods ( 2.048 ms ) in one second, the time base of the door sequence */
+#define DOOR_TICKS_PER_SECOND  			488
+
+/* Speed of the door motor between its soft start and soft stop ramps, in percent */
+#define DOOR_CRUISE_SPEED      			100
+
+/* Times the door opens again when the motor stalls on an obstacle while closing */
+#define DOOR_STALL_REOPENS     			1
+
+/* Definitions for the Emergency Stop push button ( active low, on INT2 ) */
+#define EMERGENCY_STOP_INT     			EXT_INT2
+
+/* Definitions for the door limit switches ( active low, closed when the door reaches the end of its travel ) */
+#define DOOR_OPEN_LIMIT_INT    			EXT_INT0
+#define DOOR_OPEN_LIMIT_PORT_ID			EXT_INT0_PORT_ID
+#define DOOR_OPEN_LIMIT_PIN_ID 			EXT_INT0_PIN_ID
+#define DOOR_CLOSED_LIMIT_INT  			EXT_INT1
+#define DOOR_CLOSED_LIMIT_PORT_ID		EXT_INT1_PORT_ID
+#define DOOR_CLOSED_LIMIT_PIN_ID		EXT_INT1_PIN_ID
+#define DOOR_LIMIT_PRESSED     			LOGIC_LOW
+
 /* Definitions for TWI */
 #define TWI_ADDRESS    0b0000001
 
+/* Entry of the command dispatch table */
+typedef struct
+{
+	void (*handler)(void);
+	uint8 info; /* Payload length or CMD_PAYLOAD_PIN, with CMD_NEEDS_AUTH */
+}CONTROL_CommandType;
+
+/*
+ * Configuration block in the external EEPROM, the CRC-8 covers the header and the used bytes of the PIN.
+ * Only those bytes and the CRC are written, the CRC keeps its place after the largest PIN.
+ */
+typedef struct
+{
+	uint8 magic;
+	uint8 version;
+	uint8 password[PIN_MAX_BYTES];
+	uint8 crc;
+}CONTROL_ConfigType;
+
+/* Lockout record in the external EEPROM, the CRC-8 covers all the bytes before it */
+typedef struct
+{
+	uint8 mistakes;
+	uint8 level;    /* Lockouts since the last right password up to LOCKOUT_MAX_LEVEL + 1, gives the lockout time */
+	uint16 seconds; /* Lockout time left, 0 when not locked */
+	uint8 crc;
+}CONTROL_LockoutType;
+
+/* States of the door sequence */
+typedef enum
+{
+	DOOR_IDLE, DOOR_OPENING, DOOR_HOLD, DOOR_CLOSING
+}CONTROL_DoorState;
+
 
 /*
  * Description:
- * Function to set the call back function for the Interrupt to be executed
+ * Call back function of the one second TIMER1 interrupt, counts the lockout and the alarm down
  */
 void CONTROL_TimerCallBackProcessing(void);
 
@@ -49,12 +153,188 @@ void CONTROL_TimerCallBackProcessing(void);
  */
 void CONTROL_startTimer(void);
 
+/*
+ * Description:
+ * Return the lockout seconds left, 0 when the passwords are accepted
+ */
+uint16 CONTROL_lockoutSecondsLeft(void);
+
+/*
+ * Description:
+ * Return the whole time of the last lockout, from the lockout level ( 0 before the first lockout )
+ */
+uint16 CONTROL_lockoutLength(void);
+
+/*
+ * Description:
+ * Read the lockout record from the external EEPROM and resume the lockout that was running at the reset
+ */
+void CONTROL_loadLockout(void);
+
+/*
+ * Description:
+ * Write the mistakes, the lockout level and the lockout time left in the external EEPROM
+ */
+void CONTROL_saveLockout(void);
+
+/*
+ * Description:
+ * Main loop work of the lockout: save the time left when the TIMER1 interrupt asks for it
+ * and stop the timer at the end of the lockout
+ */
+void CONTROL_lockoutService(void);
+
+/*
+ * Description:
+ * Return the DOOR_PHASE of the door sequence, the seconds are rounded up
+ */
+uint8 CONTROL_doorPhase(void);
+
+/*
+ * Description:
+ * Main loop work of the door sequence started by OPEN_DOOR: send a DOOR_STATUS frame to the HMI MCU
+ * at every change of state or second, until the door is idle again or the HMI MCU sends a frame of its own
+ */
+void CONTROL_doorService(void);
+
+/*
+ * Description:
+ * Forget the mistakes and the lockout level after a right password, the record is saved from the main loop
+ */
+void CONTROL_clearMistakes(void);
+
+/*
+ * Description:
+ * Open a session after a right password, its new token is sent before the next reply
+ */
+void CONTROL_startSession(void);
+
+/*
+ * Description:
+ * Send the reply of a command to the HMI MCU, after SESSION and the token of a session just opened
+ */
+void CONTROL_sendReply(uint8 reply);
+
+/*
+ * Description:
+ * Take one operation of the session if the token is the one of the open session
+ * Return TRUE if the command may run without the password
+ */
+boolean CONTROL_useSession(uint16 token);
+
+/*
+ * Description:
+ * Close the session, its token is refused from now on
+ */
+void CONTROL_endSession(void);
+
+/*
+ * Description:
+ * Call back function of the PWM period interrupt ( Timer0 overflow, every 2.048 ms ),
+ * runs the DC Motor ramp, the buzzer pattern sequencer, the door sequence and the session time outs
+ */
+void CONTROL_tickProcessing(void);
+
+/*
+ * Description:
+ * Call back function of the Emergency Stop interrupt, stop the DC Motor immediately and end the door sequence
+ */
+void CONTROL_emergencyStop(void);
+
+/*
+ * Description:
+ * Call back function of the open limit switch interrupt, stop the DC Motor and hold if the door is opening
+ */
+void CONTROL_doorOpenLimit(void);
+
+/*
+ * Description:
+ * Call back function of the closed limit switch interrupt, stop the DC Motor and end the sequence if the door is closing
+ */
+void CONTROL_doorClosedLimit(void);
+
+/*
+ * Description:
+ * Call back function of the DC Motor stall, an opening door holds, a closing door opens again
+ */
+void CONTROL_doorStalled(void);
+
+/*
+ * Description:
+ * Count down the time out of the door state, move to the next state when it is over
+ */
+void CONTROL_doorTick(void);
+
+/*
+ * Description:
+ * Enter a state of the door sequence: drive the DC Motor and load the time out of the state.
+ * Called from the interrupts or with the interrupts disabled.
+ */
+void CONTROL_doorEnter(CONTROL_DoorState state);
+
 /*
  * Description:
  * Function to set a new Password
  */
 void CONTROL_newPassword(void);
 
+/*
+ * Description:
+ * Run a command of the HMI MCU from the dispatch table: receive its payload,
+ * check the password if the command needs it, then call its handler.
+ * Codes without an entry are ignored.
+ */
+void CONTROL_dispatchCommand(uint8 command);
+
+/*
+ * Description:
+ * Command handler: open the door
+ */
+void CONTROL_cmdOpenDoor(void);
+
+/*
+ * Description:
+ * Command handler: set a new password
+ */
+void CONTROL_cmdChangePassword(void);
+
+/*
+ * Description:
+ * Command handler: tell the HMI MCU if a password is set up, and set it up if not
+ */
+void CONTROL_cmdBootStatus(void);
+
+/*
+ * Description:
+ * Command handler: send the lockout seconds left and the whole lockout time to the HMI MCU
+ */
+void CONTROL_cmdLockoutStatus(void);
+
+/*
+ * Description:
+ * Command handler: send the state of the door sequence to the HMI MCU
+ */
+void CONTROL_cmdDoorStatus(void);
+
+/*
+ * Description:
+ * Command handler: run the command of a SESSION frame without the password if its token is accepted
+ */
+void CONTROL_cmdSession(void);
+
+/*
+ * Description:
+ * Command handler: dump the profiler table then skip the HMI MCU table
+ */
+void CONTROL_cmdProfileDump(void);
+
+/*
+ * Description :
+ * Receive the payload bytes of a command from UART
+ * and Store them in an array
+ */
+void CONTROL_receivePayload(uint8 a_payload[], uint8 length);
+
 /*
  * Description :
  * Takes the Password which received from UART
@@ -64,32 +344,61 @@ void CONTROL_receivePassword(uint8 a_Password[]);
 
 /*
  * Description :
- * Function to compare two passwords received from HMI MCU
+ * Function to compare two passwords received from HMI MCU,
+ * it takes the same time wherever the passwords differ
  */
 uint8 CONTROL_comparePasswords(uint8 a_password1[], uint8 a_password2[]);
 
 /*
  * Description :
- * Function that save the matched password in external EEPROM
+ * Receive the digits of a password as the user types them, up to PIN_STREAM_END,
+ * and compare each one on arrival with the stored password.
+ * Return PASS_MATCHED if all the digits and the length match, in the same time whatever the mismatch,
+ * PASS_ABORTED after DIGIT_TIMEOUT without a digit or on a byte that is not a digit ( the HMI MCU was reset )
  */
-void CONTROL_savePassword(uint8 a_receivedPassword[]);
+uint8 CONTROL_receiveDigits(const uint8 a_storedPassword[]);
 
 /*
  * Description :
- * Load the Password from EEPROM
- * and Store it in an array
+ * Return the CRC-8 ( polynomial 0x07 ) of a block of bytes
  */
-void CONTROL_readPassword(uint8 a_storedPassword[]);
+uint8 CONTROL_configCrc(const uint8 *a_data, uint8 length);
+
+/*
+ * Description :
+ * Read a number of bytes from the external EEPROM, without the storing delay
+ * Return ERROR if one of the reads failed
+ */
+uint8 CONTROL_readEeprom(uint16 address, uint8 a_data[], uint8 length);
+
+/*
+ * Description :
+ * Read the configuration block from the external EEPROM and keep its password in SRAM
+ * Return TRUE if it holds a password: right magic, version, CRC and a valid PIN
+ */
+boolean CONTROL_loadConfig(void);
+
+/*
+ * Description :
+ * Function that save the matched password in external EEPROM
+ * inside a new configuration block, the system is provisioned once it is written
+ */
+void CONTROL_savePassword(uint8 a_receivedPassword[]);
+
 
 /*
  * Description:
- * Function that rotates the DC Motor
+ * Start the door sequence ( open / hold / close ) and return at once, nothing is done if it is running.
+ * The sequence runs from the interrupts: every moving phase ends at its limit switch,
+ * or at its time out as a safety net. A motor stall ends the phase too, while closing
+ * the door opens again and retries
  */
 void CONTROL_openingDoor(void);
 
 /*
  * Description:
- * Function that take care of wrong password scenarios
+ * Function that take care of wrong password scenarios:
+ * count the mistake, start a lockout after MAX_NUM_OF_MISTAKES, save them, then answer the HMI MCU
  */
 void CONTROL_wrongPassword(void);
 
@@ -99,6 +408,13 @@ void CONTROL_wrongPassword(void);
  */
 void CONTROL_sendCommand(uint8 g_command);
 
+/*
+ * Description:
+ * Send a frame the HMI MCU didn't ask for. Give up if the HMI MCU starts a frame of its own instead,
+ * its READY_TO_SEND is taken and g_frameStarted set. Return TRUE if the frame was sent.
+ */
+boolean CONTROL_pushCommand(uint8 g_command);
+
 /*
  * Description:
  * Function to receive specific command from the HMI MCU through UART
@@ -0,0 +1,101 @@
+/*
+ * pin.c
+ * Description: Source file for the packed BCD PIN
+ *
+ */
+
+#include "pin.h"
+
+/* Nibble n of the stream: the length nibble is nibble 0, digit i is nibble i+1 */
+static uint8 PIN_getNibble(const uint8 a_pin[], uint8 nibble)
+{
+	return (nibble & 1) ? (a_pin[nibble >> 1] & 0x0F) : (a_pin[nibble >> 1] >> 4);
+}
+
+static void PIN_setNibble(uint8 a_pin[], uint8 nibble, uint8 value)
+{
+	if(nibble & 1)
+	{
+		a_pin[nibble >> 1] = (a_pin[nibble >> 1] & 0xF0) | value;
+	}
+	else
+	{
+		a_pin[nibble >> 1] = (a_pin[nibble >> 1] & 0x0F) | (value << 4);
+	}
+}
+
+/*
+ * Description :
+ * Write a digit ( 0 to 9 ) at a position ( 0 to PIN_MAX_DIGITS - 1 ) of the PIN.
+ */
+void PIN_setDigit(uint8 a_pin[], uint8 index, uint8 digit)
+{
+	PIN_setNibble(a_pin, index + 1, digit);
+}
+
+/*
+ * Description :
+ * Return the digit at a position ( 0 to PIN_MAX_DIGITS - 1 ) of the PIN, the pad past its last digit.
+ */
+uint8 PIN_getDigit(const uint8 a_pin[], uint8 index)
+{
+	return PIN_getNibble(a_pin, index + 1);
+}
+
+/*
+ * Description :
+ * Write the length nibble of the PIN and pad its last byte, once all its digits are set.
+ */
+void PIN_setLength(uint8 a_pin[], uint8 length)
+{
+	PIN_setNibble(a_pin, 0, length - 1);
+
+	/* length + 1 nibbles, an even length leaves the low nibble of the last byte free */
+	if((length & 1) == 0)
+	{
+		PIN_setNibble(a_pin, length + 1, PIN_PAD);
+	}
+}
+
+/*
+ * Description :
+ * Return the number of digits of the PIN.
+ */
+uint8 PIN_getLength(const uint8 a_pin[])
+{
+	return (a_pin[0] >> 4) + 1;
+}
+
+/*
+ * Description :
+ * Return the size in bytes of the PIN.
+ */
+uint8 PIN_getSize(const uint8 a_pin[])
+{
+	return PIN_SIZE_OF(a_pin[0]);
+}
+
+/*
+ * Description :
+ * Return TRUE if the PIN has an allowed length, only decimal digits and the right pad.
+ */
+boolean PIN_isValid(const uint8 a_pin[])
+{
+	uint8 length = PIN_getLength(a_pin);
+	uint8 nibble;
+
+	if(length < PIN_MIN_DIGITS)
+	{
+		return FALSE;
+	}
+
+	for(nibble = 1; nibble <= length; nibble++)
+	{
+		if(PIN_getNibble(a_pin, nibble) > 9)
+		{
+			return FALSE;
+		}
+	}
+
+	return ((length & 1) != 0) || (PIN_getNibble(a_pin, length + 1) == PIN_PAD);
+}
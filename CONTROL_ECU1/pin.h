@@ -0,0 +1,77 @@
+/*
+ * pin.h
+ * Description: Header file for the packed BCD PIN
+ *
+ * A PIN of PIN_MIN_DIGITS to PIN_MAX_DIGITS digits is kept as a nibble stream,
+ * two nibbles per byte with the high nibble first:
+ * 		( length - 1 ), digit 0, digit 1, ... , digit length-1, [ PIN_PAD ]
+ * so the first byte gives the size of the whole PIN and a 5 digits PIN takes 3 bytes.
+ * The same bytes are used in SRAM, on the UART and in the EEPROM.
+ */
+
+#ifndef PIN_H_
+#define PIN_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+#define PIN_MIN_DIGITS                 4
+#define PIN_MAX_DIGITS                 16
+
+/* Size in bytes of a PIN of length digits, the length nibble included */
+#define PIN_SIZE(length)               (((length) + 2) / 2)
+#define PIN_MAX_BYTES                  PIN_SIZE(PIN_MAX_DIGITS)
+
+/* Size in bytes of a PIN from its first byte */
+#define PIN_SIZE_OF(first_byte)        PIN_SIZE(((first_byte) >> 4) + 1)
+
+/* Nibble filling the last byte when the nibble count is odd */
+#define PIN_PAD                        0x0F
+
+/* Byte ending a PIN sent digit by digit, it is not a digit */
+#define PIN_STREAM_END                 PIN_PAD
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Write a digit ( 0 to 9 ) at a position ( 0 to PIN_MAX_DIGITS - 1 ) of the PIN.
+ */
+void PIN_setDigit(uint8 a_pin[], uint8 index, uint8 digit);
+
+/*
+ * Description :
+ * Return the digit at a position ( 0 to PIN_MAX_DIGITS - 1 ) of the PIN, the pad past its last digit.
+ */
+uint8 PIN_getDigit(const uint8 a_pin[], uint8 index);
+
+/*
+ * Description :
+ * Write the length nibble of the PIN and pad its last byte, once all its digits are set.
+ */
+void PIN_setLength(uint8 a_pin[], uint8 length);
+
+/*
+ * Description :
+ * Return the number of digits of the PIN.
+ */
+uint8 PIN_getLength(const uint8 a_pin[]);
+
+/*
+ * Description :
+ * Return the size in bytes of the PIN.
+ */
+uint8 PIN_getSize(const uint8 a_pin[]);
+
+/*
+ * Description :
+ * Return TRUE if the PIN has an allowed length, only decimal digits and the right pad.
+ */
+boolean PIN_isValid(const uint8 a_pin[]);
+
+#endif /* PIN_H_ */
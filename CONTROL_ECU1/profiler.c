@@ -0,0 +1,185 @@
+/*
+ * profiler.c
+ * Description: Source file for the hot-path cycle profiler
+ *
+ */
+
+#include "profiler.h"
+
+#if PROF_ENABLE
+
+#include <avr/io.h> /* To use the Timer1 Registers */
+#include <avr/interrupt.h> /* For cli() */
+#include "uart.h"
+
+/* Timer1 configuration owned by the profiler: normal mode, no prescaler */
+#define PROF_TIMER1_CONTROL            (1<<CS10)
+
+/* Probe records table */
+static PROF_RecordType g_profRecords[PROF_NUM_OF_PROBES];
+
+/* Cycles spent by an empty probe, subtracted from every sample */
+static uint16 g_profOverhead = 0;
+
+/*
+ * Description :
+ * Start Timer1 free running at F_CPU, measure the cost of an empty probe
+ * and clear all the probe records.
+ */
+void PROF_init(void)
+{
+	uint16 start;
+
+	TCCR1A = 0;
+	TCCR1B = PROF_TIMER1_CONTROL;
+
+	/* Calibrate the overhead of the two time stamps */
+	start = TCNT1;
+	g_profOverhead = (uint16)(TCNT1 - start);
+
+	PROF_reset();
+}
+
+/*
+ * Description :
+ * Clear all the probe records.
+ */
+void PROF_reset(void)
+{
+	uint8 probe;
+	uint8 sreg = SREG;
+
+	cli();
+	for(probe = 0; probe < PROF_NUM_OF_PROBES; probe++)
+	{
+		g_profRecords[probe].calls = 0;
+		g_profRecords[probe].total_cycles = 0;
+		g_profRecords[probe].min_cycles = 0xFFFF;
+		g_profRecords[probe].max_cycles = 0;
+	}
+	SREG = sreg;
+}
+
+/*
+ * Description :
+ * Accumulate one measured interval in the record of the required probe.
+ * Samples taken while the application has Timer1 in another configuration are dropped,
+ * if the application stopped Timer1 the profiler takes it back.
+ */
+void PROF_record(PROF_ProbeId probe_id, uint16 cycles)
+{
+	PROF_RecordType *record = &g_profRecords[probe_id];
+	uint8 sreg;
+
+	if(TCCR1B != PROF_TIMER1_CONTROL)
+	{
+		if(TCCR1B == 0)
+		{
+			/* Timer1 was released by the application, start counting again */
+			TCCR1A = 0;
+			TCCR1B = PROF_TIMER1_CONTROL;
+		}
+		return;
+	}
+
+	cycles = (cycles > g_profOverhead) ? (cycles - g_profOverhead) : 0;
+
+	/* The same probe may also be hit from an ISR */
+	sreg = SREG;
+	cli();
+	if(record->calls != 0xFFFF)
+	{
+		record->calls++;
+		record->total_cycles += cycles;
+		if(cycles < record->min_cycles)
+		{
+			record->min_cycles = cycles;
+		}
+		if(cycles > record->max_cycles)
+		{
+			record->max_cycles = cycles;
+		}
+	}
+	SREG = sreg;
+}
+
+/*
+ * Description :
+ * Send the probe records table as one binary frame through UART.
+ * All the multi-byte fields are sent least significant byte first.
+ */
+void PROF_dump(void)
+{
+	PROF_RecordType record;
+	uint8 probe;
+	uint8 checksum = PROF_MCU_ID + PROF_NUM_OF_PROBES;
+	uint8 field[PROF_RECORD_SIZE];
+	uint8 i;
+	uint8 sreg;
+
+	UART_sendByte(PROF_FRAME_SYNC1);
+	UART_sendByte(PROF_FRAME_SYNC2);
+	UART_sendByte(PROF_MCU_ID);
+	UART_sendByte(PROF_NUM_OF_PROBES);
+
+	for(probe = 0; probe < PROF_NUM_OF_PROBES; probe++)
+	{
+		/* Take a consistent copy of the record */
+		sreg = SREG;
+		cli();
+		record = g_profRecords[probe];
+		SREG = sreg;
+
+		field[0] = (uint8)record.calls;
+		field[1] = (uint8)(record.calls >> 8);
+		field[2] = (uint8)record.total_cycles;
+		field[3] = (uint8)(record.total_cycles >> 8);
+		field[4] = (uint8)(record.total_cycles >> 16);
+		field[5] = (uint8)(record.total_cycles >> 24);
+		field[6] = (uint8)record.min_cycles;
+		field[7] = (uint8)(record.min_cycles >> 8);
+		field[8] = (uint8)record.max_cycles;
+		field[9] = (uint8)(record.max_cycles >> 8);
+
+		for(i = 0; i < PROF_RECORD_SIZE; i++)
+		{
+			UART_sendByte(field[i]);
+			checksum += field[i];
+		}
+	}
+
+	UART_sendByte(checksum);
+}
+
+/*
+ * Description :
+ * Receive and drop one dump frame sent by the other MCU through UART.
+ */
+void PROF_discardFrame(void)
+{
+	uint16 remaining;
+
+	/* Wait for the frame sync bytes */
+	while(1)
+	{
+		if(UART_recieveByte() == PROF_FRAME_SYNC1)
+		{
+			if(UART_recieveByte() == PROF_FRAME_SYNC2)
+			{
+				break;
+			}
+		}
+	}
+
+	UART_recieveByte(); /* MCU id */
+
+	/* Records of all the probes then the checksum */
+	remaining = (uint16)UART_recieveByte() * PROF_RECORD_SIZE + 1;
+	while(remaining != 0)
+	{
+		UART_recieveByte();
+		remaining--;
+	}
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * pwm.c
+ * Description: Source file for the Timer0 fast PWM driver
+ *
+ */
+
+#include <avr/io.h> /* To use the Timer0 Registers */
+#include "pwm.h"
+#include "gpio.h"
+
+/*
+ * Description :
+ * Start Timer0 in fast PWM mode with a 0% duty cycle on OC0
+ * and enable its overflow interrupt.
+ */
+void PWM_Timer0_Init(void)
+{
+	GPIO_WRITE_PIN(PWM_OC0_PORT_ID, PWM_OC0_PIN_ID, LOGIC_LOW); /* Held low while OC0 is disconnected */
+	GPIO_SETUP_PIN_DIRECTION(PWM_OC0_PORT_ID, PWM_OC0_PIN_ID, PIN_OUTPUT);
+
+	TCNT0 = 0;
+	OCR0 = 0;
+
+	/* Fast PWM mode, OC0 disconnected until a duty cycle is set */
+	TCCR0 = (1<<WGM00) | (1<<WGM01) | PWM_TIMER0_CLOCK;
+
+	/* The overflow interrupt gives the PWM user a tick every period */
+	TIMSK |= (1<<TOIE0);
+}
+
+/*
+ * Description :
+ * Set the duty cycle of OC0 (0 to PWM_MAX_DUTY), it takes effect at the next PWM period.
+ * With 0 the pin is disconnected from the timer and held low, so it gives no spike every period.
+ */
+void PWM_Timer0_setDutyCycle(uint8 duty_cycle)
+{
+	OCR0 = duty_cycle; /* Double buffered by the hardware, updated at the top */
+
+	if(duty_cycle == 0)
+	{
+		TCCR0 &= ~(1<<COM01); /* OC0 back to the PORT value ( low ) */
+	}
+	else
+	{
+		TCCR0 |= (1<<COM01); /* Non-inverting mode: clear OC0 on compare match, set OC0 at the bottom */
+	}
+}
+
+/*
+ * Description :
+ * Stop Timer0 and hold OC0 low.
+ */
+void PWM_Timer0_DeInit(void)
+{
+	TCCR0 = 0;
+	TCNT0 = 0;
+	OCR0 = 0;
+	TIMSK &= ~(1<<TOIE0);
+}
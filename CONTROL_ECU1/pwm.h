@@ -0,0 +1,54 @@
+/*
+ * pwm.h
+ * Description: Header file for the Timer0 fast PWM driver
+ *
+ * Timer0 runs in fast PWM mode and drives the OC0 pin (PB3) non-inverted,
+ * its overflow interrupt calls the TIMER0 call back of the timer driver
+ * once every PWM period, so it can be used as a tick by the PWM user.
+ */
+
+#ifndef PWM_H_
+#define PWM_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* OC0 pin, the output of the PWM */
+#define PWM_OC0_PORT_ID                PORTB_ID
+#define PWM_OC0_PIN_ID                 PIN3_ID
+
+/* Timer0 prescaler bits: F_CPU/8, 1 MHz / 8 / 256 = 488 Hz PWM, one period = 2.048 ms */
+#define PWM_TIMER0_CLOCK               (1<<CS01)
+#define PWM_PERIOD_US                  2048
+
+/* Top of the duty cycle */
+#define PWM_MAX_DUTY                   255
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Start Timer0 in fast PWM mode with a 0% duty cycle on OC0
+ * and enable its overflow interrupt.
+ */
+void PWM_Timer0_Init(void);
+
+/*
+ * Description :
+ * Set the duty cycle of OC0 (0 to PWM_MAX_DUTY), it takes effect at the next PWM period.
+ * With 0 the pin is disconnected from the timer and held low, so it gives no spike every period.
+ */
+void PWM_Timer0_setDutyCycle(uint8 duty_cycle);
+
+/*
+ * Description :
+ * Stop Timer0 and hold OC0 low.
+ */
+void PWM_Timer0_DeInit(void);
+
+#endif /* PWM_H_ */
@@ -8,6 +8,8 @@ C_SRCS += \
 ../keypad.c \
 ../lcd.c \
 ../main.c \
+../pin.c \
+../profiler.c \
 ../timer.c \
 ../uart.c 
 
@@ -16,6 +18,8 @@ OBJS += \
 ./keypad.o \
 ./lcd.o \
 ./main.o \
+./pin.o \
+./profiler.o \
 ./timer.o \
 ./uart.o 
 
@@ -24,6 +28,8 @@ C_DEPS += \
 ./keypad.d \
 ./lcd.d \
 ./main.d \
+./pin.d \
+./profiler.d \
 ./timer.d \
 ./uart.d 
 
@@ -32,7 +38,7 @@ C_DEPS += \
 %.o: ../%.c subdir.mk
 	@echo 'Building file: $<'
 	@echo 'Invoking: AVR Compiler'
-	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
+	avr-gcc -Wall -g2 -gstabs -Os -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
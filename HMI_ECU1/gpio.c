@@ -7,6 +7,40 @@
 #include "gpio.h"
 #include "common_macros.h" /* To use the macros like SET_BIT */
 #include "avr/io.h" /* To use the IO Ports Registers */
+#include <avr/interrupt.h> /* For cli() and the ISRs */
+
+/* Global variables to hold the address of the call back functions of the external interrupts */
+static void (*volatile g_int0CallBackPtr)(void) = NULL_PTR;
+static void (*volatile g_int1CallBackPtr)(void) = NULL_PTR;
+static void (*volatile g_int2CallBackPtr)(void) = NULL_PTR;
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+
+ISR(INT0_vect)
+{
+	if(g_int0CallBackPtr != NULL_PTR)
+	{
+		(*g_int0CallBackPtr)();
+	}
+}
+
+ISR(INT1_vect)
+{
+	if(g_int1CallBackPtr != NULL_PTR)
+	{
+		(*g_int1CallBackPtr)();
+	}
+}
+
+ISR(INT2_vect)
+{
+	if(g_int2CallBackPtr != NULL_PTR)
+	{
+		(*g_int2CallBackPtr)();
+	}
+}
 
 /*
  * Description :
@@ -323,3 +357,189 @@ uint8 GPIO_readPort(uint8 port_num)
 
 	return value;
 }
+
+/*
+ * Description :
+ * Write the value bits selected by the mask on the required port in one register write,
+ * the other pins of the port keep their values.
+ * The read-modify-write is done with interrupts disabled so an ISR using the same port can not corrupt it.
+ * If the input port number is not correct, The function will not handle the request.
+ */
+void GPIO_writeMasked(uint8 port_num, uint8 mask, uint8 value)
+{
+	uint8 sreg;
+
+	/*
+	 * Check if the input number is greater than NUM_OF_PORTS value.
+	 * In this case the input is not valid port number
+	 */
+	if(port_num >= NUM_OF_PORTS)
+	{
+		/* Do Nothing */
+	}
+	else
+	{
+		value &= mask;
+
+		/* Save the interrupts state and disable them during the read-modify-write */
+		sreg = SREG;
+		cli();
+
+		/* Write the masked bits as required */
+		switch(port_num)
+		{
+		case PORTA_ID:
+			PORTA = (PORTA & ~mask) | value;
+			break;
+		case PORTB_ID:
+			PORTB = (PORTB & ~mask) | value;
+			break;
+		case PORTC_ID:
+			PORTC = (PORTC & ~mask) | value;
+			break;
+		case PORTD_ID:
+			PORTD = (PORTD & ~mask) | value;
+			break;
+		}
+
+		/* Restore the interrupts state */
+		SREG = sreg;
+	}
+}
+
+/*
+ * Description :
+ * Toggle the pins selected by the mask on the required port in one register write.
+ * The read-modify-write is done with interrupts disabled so an ISR using the same port can not corrupt it.
+ * If the input port number is not correct, The function will not handle the request.
+ */
+void GPIO_toggleMasked(uint8 port_num, uint8 mask)
+{
+	uint8 sreg;
+
+	/*
+	 * Check if the input number is greater than NUM_OF_PORTS value.
+	 * In this case the input is not valid port number
+	 */
+	if(port_num >= NUM_OF_PORTS)
+	{
+		/* Do Nothing */
+	}
+	else
+	{
+		/* Save the interrupts state and disable them during the read-modify-write */
+		sreg = SREG;
+		cli();
+
+		/* Toggle the masked bits as required */
+		switch(port_num)
+		{
+		case PORTA_ID:
+			PORTA ^= mask;
+			break;
+		case PORTB_ID:
+			PORTB ^= mask;
+			break;
+		case PORTC_ID:
+			PORTC ^= mask;
+			break;
+		case PORTD_ID:
+			PORTD ^= mask;
+			break;
+		}
+
+		/* Restore the interrupts state */
+		SREG = sreg;
+	}
+}
+
+/*
+ * Description :
+ * Setup the required external interrupt (INT0 on PD2, INT1 on PD3, INT2 on PB2):
+ * 1. Configure its pin as input, the internal pull-up can be enabled later by GPIO_writePin.
+ * 2. Select the sense of the interrupt, INT2 only accepts INT_FALLING_EDGE or INT_RISING_EDGE.
+ * 3. Clear any pending request and enable the interrupt.
+ * If the interrupt id or the sense are not correct, The function will not handle the request.
+ */
+void GPIO_setupExternalInterrupt(GPIO_ExternalInterruptId int_id, GPIO_InterruptSenseType sense)
+{
+	switch(int_id)
+	{
+	case EXT_INT0:
+		GPIO_SETUP_PIN_DIRECTION(EXT_INT0_PORT_ID,EXT_INT0_PIN_ID,PIN_INPUT);
+		/* Insert the sense in ISC01:ISC00 */
+		MCUCR = (MCUCR & 0xFC) | (sense & 0x03);
+		GIFR = (1<<INTF0); /* Clear the flag by writing one */
+		SET_BIT(GICR,INT0);
+		break;
+	case EXT_INT1:
+		GPIO_SETUP_PIN_DIRECTION(EXT_INT1_PORT_ID,EXT_INT1_PIN_ID,PIN_INPUT);
+		/* Insert the sense in ISC11:ISC10 */
+		MCUCR = (MCUCR & 0xF3) | ((sense & 0x03) << ISC10);
+		GIFR = (1<<INTF1); /* Clear the flag by writing one */
+		SET_BIT(GICR,INT1);
+		break;
+	case EXT_INT2:
+		if((sense == INT_FALLING_EDGE) || (sense == INT_RISING_EDGE))
+		{
+			GPIO_SETUP_PIN_DIRECTION(EXT_INT2_PORT_ID,EXT_INT2_PIN_ID,PIN_INPUT);
+			/* INT2 must be disabled while ISC2 changes, then its flag must be cleared */
+			CLEAR_BIT(GICR,INT2);
+			if(sense == INT_RISING_EDGE)
+			{
+				SET_BIT(MCUCSR,ISC2);
+			}
+			else
+			{
+				CLEAR_BIT(MCUCSR,ISC2);
+			}
+			GIFR = (1<<INTF2); /* Clear the flag by writing one */
+			SET_BIT(GICR,INT2);
+		}
+		break;
+	}
+}
+
+/*
+ * Description :
+ * Disable the required external interrupt.
+ * If the interrupt id is not correct, The function will not handle the request.
+ */
+void GPIO_disableExternalInterrupt(GPIO_ExternalInterruptId int_id)
+{
+	switch(int_id)
+	{
+	case EXT_INT0:
+		CLEAR_BIT(GICR,INT0);
+		break;
+	case EXT_INT1:
+		CLEAR_BIT(GICR,INT1);
+		break;
+	case EXT_INT2:
+		CLEAR_BIT(GICR,INT2);
+		break;
+	}
+}
+
+/*
+ * Description :
+ * Function to set the Call Back Function Address of the required external interrupt.
+ */
+void GPIO_setExternalInterruptCallBack(void(*a_ptr)(void), GPIO_ExternalInterruptId int_id)
+{
+	switch(int_id)
+	{
+	case EXT_INT0:
+		/* Save the address of the Call back function in a global variable */
+		g_int0CallBackPtr = a_ptr;
+		break;
+	case EXT_INT1:
+		/* Save the address of the Call back function in a global variable */
+		g_int1CallBackPtr = a_ptr;
+		break;
+	case EXT_INT2:
+		/* Save the address of the Call back function in a global variable */
+		g_int2CallBackPtr = a_ptr;
+		break;
+	}
+}
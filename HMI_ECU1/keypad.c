@@ -2,124 +2,256 @@
  * keypad.c
  * Description: Source of the keypad module
  */
+#include<avr/pgmspace.h> /* To read the key tables from flash */
+#include<avr/interrupt.h> /* For cli() */
 #include"gpio.h"
 #include"keypad.h"
 #include"common_macros.h"
+#include"profiler.h"
 
+/*
+ * Key index = (col*NUM_OF_ROWS)+row, so one column read gives NUM_OF_ROWS neighbouring bits of the matrix bitmap.
+ * The tables map the key index to the key value written on the keypad.
+ */
 #if(NUM_OF_COLS == 4)
-static uint8 KEYPAD_4x4_adjustKeyNumber(uint8);
+static const uint8 g_keypadKeys[KEYPAD_NUM_OF_KEYS] PROGMEM = {
+	7,   4,   1,   13,  /* col 0 */
+	8,   5,   2,   0,   /* col 1 */
+	9,   6,   3,   '=', /* col 2 */
+	'/', '*', '-', '+'  /* col 3 */
+};
 #elif(NUM_OF_COLS ==3)
-static uint8 KEYPAD_4x3_adjustKeyNumber(uint8);
+static const uint8 g_keypadKeys[KEYPAD_NUM_OF_KEYS] PROGMEM = {
+	1,   4,   7,   '*', /* col 0 */
+	2,   5,   8,   0,   /* col 1 */
+	3,   6,   9,   '#'  /* col 2 */
+};
 #endif
 
-uint8 KEYPAD_getPressedKey(void){
-	uint8 row,col,keypad_port_value=0; // local variables for the keypad
-	while(1){
-		/* we need to output logic(high or low) to a specific col and loop for the rows
-		 * */
-		for(col=0;col<NUM_OF_COLS;col++){
-			GPIO_setupPortDirection(KEYPAD_PORT_ID,PORT_INPUT);
-			GPIO_setupPinDirection(KEYPAD_PORT_ID,KEYPAD_FIRST_COL_PIN_ID+col,PIN_OUTPUT);
+/* Index of the lowest set bit of every nibble, used to walk the set bits of the matrix bitmap */
+static const uint8 g_keypadNibbleCtz[16] PROGMEM = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+/* Row bits once the port value is shifted down to the first row pin */
+#define KEYPAD_ROWS_MASK        ((1<<NUM_OF_ROWS)-1)
+
+/* Event FIFO: one byte per event, the key index in the low nibble and the event type above it */
+#define KEYPAD_EVENT_TYPE_SHIFT 4
+#define KEYPAD_EVENT_KEY_MASK   0x0F
+
+/* Debounce integrator of every key: counts up while the key reads pressed and down while it reads released */
+static uint8 g_keypadIntegrator[KEYPAD_NUM_OF_KEYS];
+
+/* Scans since every debounced press, 0 while the key is released, saturates at KEYPAD_LONG_PRESS_SCANS */
+static uint8 g_keypadHoldTime[KEYPAD_NUM_OF_KEYS];
+
+/* Keys whose state machine is not idle, lets the scan skip the keys that are released and stable */
+static uint16 g_keypadActiveKeys = 0;
+
+/* Debounced pressed keys, one bit per key index */
+static volatile uint16 g_keypadPressedKeys = 0;
+
+/*
+ * Lock-free single producer / single consumer FIFO:
+ * only KEYPAD_scan() writes the head and only KEYPAD_getEvent() writes the tail,
+ * one byte indices are read and written atomically.
+ */
+static volatile uint8 g_keypadEvents[KEYPAD_EVENT_QUEUE_SIZE];
+static volatile uint8 g_keypadEventHead = 0;
+static volatile uint8 g_keypadEventTail = 0;
+
+/* Events dropped because the FIFO was full, only written by KEYPAD_scan() */
+static volatile uint8 g_keypadLostEvents = 0;
+
+#if PROF_ENABLE
+/* Timer1 count when every queued event was pushed, and the one of the last event taken */
+static volatile uint16 g_keypadEventTimes[KEYPAD_EVENT_QUEUE_SIZE];
+static uint16 g_keypadTakenTime;
+#endif
+
+/* Push one event in the FIFO, the event is dropped and counted if the FIFO is full */
+static void KEYPAD_pushEvent(uint8 key_index, KEYPAD_EventType type){
+	uint8 next_head = (g_keypadEventHead + 1) & (KEYPAD_EVENT_QUEUE_SIZE - 1);
+	if(!(KEYPAD_QUEUED_EVENTS & (1<<type))){
+		return;
+	}
+	if(next_head != g_keypadEventTail){
+		g_keypadEvents[g_keypadEventHead] = key_index | (type << KEYPAD_EVENT_TYPE_SHIFT);
+#if PROF_ENABLE
+		g_keypadEventTimes[g_keypadEventHead] = TCNT1;
+#endif
+		g_keypadEventHead = next_head;
+	}
+	else if(g_keypadLostEvents != 0xFF){
+		g_keypadLostEvents++;
+	}
+}
+
+/* Index of the lowest set bit, bits must not be zero */
+static uint8 KEYPAD_lowestKey(uint16 bits){
+	uint8 base = 0;
+	if((uint8)bits == 0){
+		bits >>= 8;
+		base = 8;
+	}
+	if((bits & 0x0F) == 0){
+		bits >>= 4;
+		base += 4;
+	}
+	return base + pgm_read_byte(&g_keypadNibbleCtz[bits & 0x0F]);
+}
+
+/*
+ * Read the whole matrix and return one bit per pressed key, several keys may be pressed together.
+ * Each column takes one direction write and one port write, then all its rows come from one port read.
+ */
+static uint16 KEYPAD_readMatrix(void){
+	uint8 col,row_bits;
+	uint8 col_mask = (1<<(KEYPAD_FIRST_COL_PIN_ID+NUM_OF_COLS-1)); /* start from the last col */
+	uint16 pressed_keys = 0;
+	for(col=0;col<NUM_OF_COLS;col++){
+		GPIO_SETUP_PORT_DIRECTION(KEYPAD_PORT_ID,col_mask); /* only the current col is output */
 #if(KEYPAD_BUTTON_PRESSED == LOGIC_LOW)
-			keypad_port_value=~(1<<(KEYPAD_FIRST_COL_PIN_ID+col));
+		GPIO_WRITE_PORT(KEYPAD_PORT_ID,(uint8)~col_mask); /* current col low, pull-ups on the rows */
+		__asm__ __volatile__ ("nop"); /* let the new level pass the input synchronizer */
+		row_bits = ~GPIO_READ_PORT(KEYPAD_PORT_ID);
 #else
-			keypad_port_value=(1<<(KEYPAD_FIRST_COL_PIN_ID+col));
-#endif
-			GPIO_writePort(KEYPAD_PORT_ID,keypad_port_value);
-			for(row=0;row<NUM_OF_ROWS;row++){
-				if(GPIO_readPin(KEYPAD_PORT_ID,KEYPAD_FIRST_ROW_PIN_ID+row) == KEYPAD_BUTTON_PRESSED){
-#if(NUM_OF_COLS == 4)
-					return KEYPAD_4x4_adjustKeyNumber((row*NUM_OF_COLS)+col+1);
-#elif(NUM_OF_COLS ==3)
-					return KEYPAD_4x3_adjustKeyNumber((row*NUM_OF_COLS)+col+1);
+		GPIO_WRITE_PORT(KEYPAD_PORT_ID,col_mask);
+		__asm__ __volatile__ ("nop"); /* let the new level pass the input synchronizer */
+		row_bits = GPIO_READ_PORT(KEYPAD_PORT_ID);
 #endif
-				}
+		row_bits = (row_bits >> KEYPAD_FIRST_ROW_PIN_ID) & KEYPAD_ROWS_MASK;
+		pressed_keys = (pressed_keys << NUM_OF_ROWS) | row_bits;
+		col_mask >>= 1;
+	}
+	return pressed_keys;
+}
+
+void KEYPAD_scan(void){
+	uint8 key;
+	uint16 key_mask;
+	uint16 pressed_keys;
+	uint16 scan_keys;
+
+	PROF_BEGIN(PROF_KEYPAD_SCAN);
 
+	pressed_keys = KEYPAD_readMatrix();
+
+	/* only the keys that read pressed or whose state machine is not idle need work */
+	scan_keys = pressed_keys | g_keypadActiveKeys;
+	while(scan_keys != 0){
+		key = KEYPAD_lowestKey(scan_keys);
+		key_mask = scan_keys & (~scan_keys + 1); /* lowest set bit */
+		scan_keys &= ~key_mask;
+
+		/* debounce: the integrator must reach one of its ends to change the key state */
+		if(pressed_keys & key_mask){
+			if(g_keypadIntegrator[key] < KEYPAD_DEBOUNCE_SCANS){
+				g_keypadIntegrator[key]++;
+			}
+		}
+		else if(g_keypadIntegrator[key] > 0){
+			g_keypadIntegrator[key]--;
+		}
+
+		if(g_keypadHoldTime[key] == 0){
+			/* released state */
+			if(g_keypadIntegrator[key] == KEYPAD_DEBOUNCE_SCANS){
+				g_keypadHoldTime[key] = 1;
+				g_keypadPressedKeys |= key_mask;
+				KEYPAD_pushEvent(key,KEYPAD_PRESS);
+			}
+		}
+		else if(g_keypadIntegrator[key] == 0){
+			/* pressed state and the release is stable */
+			g_keypadHoldTime[key] = 0;
+			g_keypadPressedKeys &= ~key_mask;
+			KEYPAD_pushEvent(key,KEYPAD_RELEASE);
+		}
+		else if(g_keypadHoldTime[key] < KEYPAD_LONG_PRESS_SCANS){
+			/* pressed state, count the hold time until the long press */
+			g_keypadHoldTime[key]++;
+			if(g_keypadHoldTime[key] == KEYPAD_LONG_PRESS_SCANS){
+				KEYPAD_pushEvent(key,KEYPAD_LONG_PRESS);
 			}
+		}
 
+		if((g_keypadIntegrator[key] == 0) && (g_keypadHoldTime[key] == 0)){
+			g_keypadActiveKeys &= ~key_mask;
+		}
+		else{
+			g_keypadActiveKeys |= key_mask;
 		}
 	}
+
+	PROF_END(PROF_KEYPAD_SCAN);
 }
 
+boolean KEYPAD_getEvent(KEYPAD_Event *event){
+	uint8 raw_event;
 
-#if(NUM_OF_COLS == 4)
-/*this function is called by the modules itself so the application layer doesn't have the right to call it
- * so, we must make the function static..
- * */
-static uint8 KEYPAD_4x4_adjustKeyNumber(uint8 button_number){
-	uint8 keypad_button=0;
-	switch (button_number){
-	case 1:
-		keypad_button=7;
-		break;
-	case 2:
-		keypad_button=8;
-		break;
-	case 3:
-		keypad_button=9;
-		break;
-	case 4:
-		keypad_button='/';
-		break;
-	case 5:
-		keypad_button=4;
-		break;
-	case 6:
-		keypad_button=5;
-		break;
-	case 7:
-		keypad_button=6;
-		break;
-	case 8:
-		keypad_button='*';
-		break;
-	case 9:
-		keypad_button=1;
-		break;
-	case 10:
-		keypad_button=2;
-		break;
-	case 11:
-		keypad_button=3;
-		break;
-	case 12:
-		keypad_button='-';
-		break;
-	case 13:
-		keypad_button=13;
-		break;
-	case 14:
-		keypad_button=0;
-		break;
-	case 15:
-		keypad_button='=';
-		break;
-	case 16:
-		keypad_button='+';
-		break;
-	default:
-		keypad_button = button_number;
-		break;
+	if(g_keypadEventTail == g_keypadEventHead){
+		return FALSE;
 	}
-	return keypad_button;
+
+	raw_event = g_keypadEvents[g_keypadEventTail];
+#if PROF_ENABLE
+	g_keypadTakenTime = g_keypadEventTimes[g_keypadEventTail];
+#endif
+	g_keypadEventTail = (g_keypadEventTail + 1) & (KEYPAD_EVENT_QUEUE_SIZE - 1);
+
+	event->key = pgm_read_byte(&g_keypadKeys[raw_event & KEYPAD_EVENT_KEY_MASK]);
+	event->type = (KEYPAD_EventType)(raw_event >> KEYPAD_EVENT_TYPE_SHIFT);
+	return TRUE;
 }
-#elif(NUM_OF_COLS ==3)
-static uint8 KEYPAD_4x3_adjustKeyNumber(uint8 button_number){
-	uint8 keypad_button=0;
-	switch (button_number){
-	case 10:
-		keypad_button='*';
-		break;
-	case 11:
-		keypad_button=0;
-		break;
-	case 12:
-		keypad_button='#';
-		break;
-	default:
-		keypad_button = button_number;
-		break;
-	}
-	return keypad_button;
+
+void KEYPAD_flush(void){
+	/* the consumer owns the tail, moving it to the head drops everything queued so far */
+	g_keypadEventTail = g_keypadEventHead;
+}
+
+uint8 KEYPAD_getLostEvents(void){
+	return g_keypadLostEvents;
+}
+
+#if PROF_ENABLE
+uint16 KEYPAD_getEventTime(void){
+	return g_keypadTakenTime;
 }
 #endif
+
+uint8 KEYPAD_getPressedKeys(uint8 a_keys[], uint8 max_keys){
+	uint8 count = 0;
+	uint16 pressed_keys;
+	uint8 sreg = SREG;
+
+	/* the bitmap is written by the scan interrupt, take it in one piece */
+	cli();
+	pressed_keys = g_keypadPressedKeys;
+	SREG = sreg;
+
+	while((pressed_keys != 0) && (count < max_keys)){
+		a_keys[count] = pgm_read_byte(&g_keypadKeys[KEYPAD_lowestKey(pressed_keys)]);
+		pressed_keys &= pressed_keys - 1; /* clear the lowest set bit */
+		count++;
+	}
+	return count;
+}
+
+boolean KEYPAD_getKey(uint8 *key){
+	KEYPAD_Event event;
+	/* the release and long press events are dropped */
+	while(KEYPAD_getEvent(&event)){
+		if(event.type == KEYPAD_PRESS){
+			*key = event.key;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+uint8 KEYPAD_getPressedKey(void){
+	uint8 key;
+	/* wait for a press event */
+	while(KEYPAD_getKey(&key) == FALSE);
+	return key;
+}
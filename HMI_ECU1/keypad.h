@@ -1,10 +1,18 @@
 /*
  * keypad.h
  * Description: Header of the keypad module
+ *
+ * The keypad is scanned in the background: KEYPAD_scan() must be called every
+ * KEYPAD_SCAN_PERIOD_MS from a timer interrupt. Each key runs its own debounce
+ * state machine and its events selected by KEYPAD_QUEUED_EVENTS are pushed in a
+ * lock-free FIFO read by KEYPAD_getEvent().
+ * Keys typed while the application is busy on the LCD or UART stay in the FIFO
+ * (type-ahead) until the application asks for them.
  */
 #ifndef KEYPAD_H_
 #define KEYPAD_H_
 #include"std_types.h"
+#include"profiler.h"
 
 
 #define NUM_OF_ROWS 4
@@ -14,6 +22,85 @@
 #define KEYPAD_FIRST_COL_PIN_ID PIN4_ID /*first pin connected to the first col*/
 #define KEYPAD_BUTTON_PRESSED LOGIC_LOW
 
+#define KEYPAD_NUM_OF_KEYS (NUM_OF_ROWS*NUM_OF_COLS)
 
+/* Background scan timing */
+#define KEYPAD_SCAN_PERIOD_MS        2
+#define KEYPAD_DEBOUNCE_SCANS        4     /* a key level must be stable for 8 ms */
+#define KEYPAD_LONG_PRESS_SCANS      250   /* a key held for 500 ms is a long press */
+
+/*
+ * Number of events the FIFO can hold, must be a power of two and at most 256.
+ * A keystroke takes two slots ( press and release ), so 15 keystrokes can be typed ahead.
+ */
+#define KEYPAD_EVENT_QUEUE_SIZE      32
+
+/* Events pushed in the FIFO, the others are dropped by the scan */
+#define KEYPAD_QUEUED_EVENTS         ((1<<KEYPAD_PRESS)|(1<<KEYPAD_RELEASE)|(1<<KEYPAD_LONG_PRESS))
+
+typedef enum
+{
+	KEYPAD_PRESS, KEYPAD_RELEASE, KEYPAD_LONG_PRESS
+}KEYPAD_EventType;
+
+typedef struct
+{
+	uint8 key;
+	KEYPAD_EventType type;
+}KEYPAD_Event;
+
+/*
+ * Description :
+ * Scan the whole keypad matrix once and update the debounce state machine of every key.
+ * Must be called every KEYPAD_SCAN_PERIOD_MS, normally from a timer interrupt.
+ */
+void KEYPAD_scan(void);
+
+/*
+ * Description :
+ * Take the oldest keypad event from the FIFO without blocking.
+ * Return TRUE and fill the event if there was one, otherwise return FALSE.
+ */
+boolean KEYPAD_getEvent(KEYPAD_Event *event);
+
+/*
+ * Description :
+ * Drop all the events waiting in the FIFO, used where type-ahead keys must not be replayed.
+ */
+void KEYPAD_flush(void);
+
+/*
+ * Description :
+ * Return the number of events dropped because the FIFO was full (saturates at 255).
+ */
+uint8 KEYPAD_getLostEvents(void);
+
+#if PROF_ENABLE
+/*
+ * Description :
+ * Return the Timer1 count of the scan that pushed the last event taken from the FIFO.
+ */
+uint16 KEYPAD_getEventTime(void);
+#endif
+
+/*
+ * Description :
+ * Fill the array with the keys that are pressed now (debounced), at most max_keys of them.
+ * Return the number of pressed keys written in the array.
+ * Without diodes on the matrix, three keys on the corners of a rectangle also show the fourth one.
+ */
+uint8 KEYPAD_getPressedKeys(uint8 a_keys[], uint8 max_keys);
+
+/*
+ * Description :
+ * Take the next key press event without blocking, the release and long press events before it are dropped.
+ * Return TRUE and fill the key if there was one, otherwise return FALSE.
+ */
+boolean KEYPAD_getKey(uint8 *key);
+
+/*
+ * Description :
+ * Wait for the next key press event and return its key.
+ */
 uint8 KEYPAD_getPressedKey(void);
 #endif /* KEYPAD_H_ */
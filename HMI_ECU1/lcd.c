@@ -6,151 +6,309 @@
  */
 
 #include <util/delay.h> /* For the delay functions */
+#include <avr/interrupt.h> /* For cli() */
+#include <avr/pgmspace.h> /* To read the strings stored in flash */
 #include "common_macros.h" /* To use the macros like SET_BIT */
 #include "lcd.h"
 #include "gpio.h"
+#include "profiler.h"
+
+#define LCD_ADDRESS_UNKNOWN            0xFF
+
+/* Cost of the clear command counted in character writes: it runs for 1.52 ms against about 50 us for a character */
+#define LCD_CLEAR_COST                 30
 
 /*******************************************************************************
- *                      Functions Definitions                                  *
+ *                      Global Variables                                       *
  *******************************************************************************/
 
+/* Screen the application draws in */
+static uint8 g_lcdShadow[LCD_ROWS][LCD_COLS];
+
+/* Screen as it is on the LCD glass */
+static uint8 g_lcdScreen[LCD_ROWS][LCD_COLS];
+
+/* Cursor of the shadow screen */
+static uint8 g_lcdCursorRow = 0;
+static uint8 g_lcdCursorCol = 0;
+
+/* Last screen published by LCD_flush, drawn on the glass by LCD_service */
+static uint8 g_lcdFrame[LCD_ROWS][LCD_COLS];
+
+/* DDRAM address counter of the LCD controller, LCD_ADDRESS_UNKNOWN after a raw command */
+static uint8 g_lcdAddress = 0;
+
+/* Next cell of the published frame LCD_service compares with the glass */
+static uint8 g_lcdScanRow = 0;
+static uint8 g_lcdScanCol = 0;
+
+/* Set by LCD_flush, the frame must be compared with the glass */
+static volatile uint8 g_lcdNewFrame = FALSE;
+static volatile uint8 g_lcdFramePending = FALSE;
+
+/* Flash glyph held by every CGRAM slot, NULL_PTR while the slot is free */
+static const uint8 *g_lcdGlyphs[LCD_GLYPH_SLOTS];
+
+/* Next CGRAM slot to replace when all of them are taken */
+static uint8 g_lcdGlyphNext = 0;
+
+/* Progress bar cells with 1 to 4 pixel columns on, a full cell uses LCD_FULL_BLOCK_CHAR */
+static const uint8 g_lcdBarGlyphs[LCD_GLYPH_WIDTH-1][LCD_GLYPH_HEIGHT] PROGMEM = {
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+	{ 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 },
+	{ 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C },
+	{ 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E }
+};
+
+/* LCD_service does nothing until LCD_init is done */
+static volatile uint8 g_lcdReady = FALSE;
+
 /*
- * Description :
- * Initialize the LCD:
- * 1. Setup the LCD pins directions by use the GPIO driver.
- * 2. Setup the LCD Data Mode 4-bits or 8-bits.
+ * Lock-free single producer / single consumer FIFO of the raw LCD writes:
+ * only LCD_queueWrite() writes the head and only LCD_service() writes the tail.
+ * Every entry holds the byte and, above it, the RS level.
  */
-void LCD_init(void)
-{
-	/* Configure the direction for RS, RW and E pins as output pins */
-	GPIO_setupPinDirection(LCD_RS_PORT_ID,LCD_RS_PIN_ID,PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_RW_PORT_ID,LCD_RW_PIN_ID,PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_E_PORT_ID,LCD_E_PIN_ID,PIN_OUTPUT);
+static volatile uint16 g_lcdQueue[LCD_QUEUE_SIZE];
+static volatile uint8 g_lcdQueueHead = 0;
+static volatile uint8 g_lcdQueueTail = 0;
 
-#if (LCD_DATA_BITS_MODE == 4)
+/*******************************************************************************
+ *                      Private Functions                                      *
+ *******************************************************************************/
 
-	/* Configure 4 pins in the data port as output pins */
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID,LCD_FIRST_DATA_PIN_ID,PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID,LCD_FIRST_DATA_PIN_ID+1,PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID,LCD_FIRST_DATA_PIN_ID+2,PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID,LCD_FIRST_DATA_PIN_ID+3,PIN_OUTPUT);
+/* DDRAM address of the first column of a row */
+static uint8 LCD_rowAddress(uint8 row)
+{
+	/* rows 2 and 3 continue rows 0 and 1 after LCD_COLS characters */
+	return ((row & 1) ? 0x40 : 0x00) + ((row & 2) ? LCD_COLS : 0);
+}
+
+/* The LCD has just been cleared: the glass holds spaces and the address counter is home */
+static void LCD_resetGlass(void)
+{
+	uint8 row,col;
+	for(row = 0; row < LCD_ROWS; row++)
+	{
+		for(col = 0; col < LCD_COLS; col++)
+		{
+			g_lcdScreen[row][col] = ' ';
+		}
+	}
+	g_lcdAddress = 0;
+}
 
-	LCD_sendCommand(LCD_GO_TO_HOME);
-	LCD_sendCommand(LCD_TWO_LINES_FOUR_BITS_MODE); /* use 2-line lcd + 4-bit Data Mode + 5*7 dot display Mode */
+#if (LCD_USE_BUSY_FLAG == TRUE)
+/* Poll the busy flag (D7) through RW until the controller can take a new byte */
+static void LCD_waitReady(void)
+{
+	uint8 busy;
 
+	/* Release the data bus to the LCD */
+#if (LCD_DATA_BITS_MODE == 4)
+	GPIO_DDR_REG(LCD_DATA_PORT_ID) &= ~LCD_DATA_PINS_MASK;
 #elif (LCD_DATA_BITS_MODE == 8)
-	/* Configure the data port as output port */
-	GPIO_setupPortDirection(LCD_DATA_PORT_ID,PORT_OUTPUT);
-	LCD_sendCommand(LCD_TWO_LINES_EIGHT_BITS_MODE); /* use 2-line lcd + 8-bit Data Mode + 5*7 dot display Mode */
+	GPIO_SETUP_PORT_DIRECTION(LCD_DATA_PORT_ID,PORT_INPUT);
+#endif
+	GPIO_WRITE_PIN(LCD_RS_PORT_ID,LCD_RS_PIN_ID,LOGIC_LOW); /* Instruction Mode RS=0 */
+	GPIO_WRITE_PIN(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_HIGH); /* read from LCD so RW=1 */
+	do
+	{
+		GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
+		_delay_us(LCD_E_PULSE_TIME_US); /* Tddr = 160ns before the data is valid */
+		busy = GPIO_READ_PIN(LCD_DATA_PORT_ID,LCD_BUSY_FLAG_PIN_ID);
+		GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
+#if (LCD_DATA_BITS_MODE == 4)
+		/* clock out the low nibble of the status, it is not needed */
+		_delay_us(LCD_E_PULSE_TIME_US);
+		GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
+		_delay_us(LCD_E_PULSE_TIME_US);
+		GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
 #endif
+	}while(busy);
+	GPIO_WRITE_PIN(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_LOW); /* write data to LCD so RW=0 */
 
-	LCD_sendCommand(LCD_CURSOR_OFF); /* cursor off */
-	LCD_sendCommand(LCD_CLEAR_COMMAND); /* clear LCD at the beginning */
+	/* Take the data bus back */
+#if (LCD_DATA_BITS_MODE == 4)
+	GPIO_DDR_REG(LCD_DATA_PORT_ID) |= LCD_DATA_PINS_MASK;
+#elif (LCD_DATA_BITS_MODE == 8)
+	GPIO_SETUP_PORT_DIRECTION(LCD_DATA_PORT_ID,PORT_OUTPUT);
+#endif
 }
+#endif
 
 /*
- * Description :
- * Send the required command to the screen
+ * Send one byte to the LCD, rs selects the instruction (LOGIC_LOW) or the data (LOGIC_HIGH) register.
+ * At 1 MHz every pin write already lasts longer than Tas = 40ns, Tdsw = 80ns and Th = 10ns,
+ * only the enable pulse width (Tpw = 230ns) needs a wait.
  */
-void LCD_sendCommand(uint8 command)
+static void LCD_write(uint8 rs, uint8 value)
 {
-	//uint8 lcd_port_value = 0;
-	GPIO_writePin(LCD_RS_PORT_ID,LCD_RS_PIN_ID,LOGIC_LOW); /* Instruction Mode RS=0 */
-	GPIO_writePin(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_LOW); /* write data to LCD so RW=0 */
-	_delay_ms(1); /* delay for processing Tas = 50ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	_delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+#if (LCD_USE_BUSY_FLAG == TRUE)
+	LCD_waitReady(); /* the previous instruction must be done */
+#endif
+	GPIO_WRITE_PIN(LCD_RS_PORT_ID,LCD_RS_PIN_ID,rs);
+	GPIO_WRITE_PIN(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_LOW); /* write data to LCD so RW=0 */
 
 #if (LCD_DATA_BITS_MODE == 4)
-	/* out the last 4 bits of the required command to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
+	/* out the last 4 bits of the required value to the data bus D4 --> D7 */
 #ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | (command & 0xF0);
+	GPIO_writeMasked(LCD_DATA_PORT_ID,LCD_DATA_PINS_MASK,value);
 #else
-	lcd_port_value = (lcd_port_value & 0xF0) | ((command & 0xF0) >> 4);
+	GPIO_writeMasked(LCD_DATA_PORT_ID,LCD_DATA_PINS_MASK,value >> 4);
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
+	GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
+	_delay_us(LCD_E_PULSE_TIME_US);
+	GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0, the LCD latches the nibble */
 
-	_delay_ms(1); /* delay for processing Tdsw = 100ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1); /* delay for processing Th = 13ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	_delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
-
-	/* out the first 4 bits of the required command to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
+	/* out the first 4 bits of the required value to the data bus D4 --> D7 */
 #ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | ((command & 0x0F) << 4);
+	GPIO_writeMasked(LCD_DATA_PORT_ID,LCD_DATA_PINS_MASK,value << 4);
 #else
-	lcd_port_value = (lcd_port_value & 0xF0) | (command & 0x0F);
+	GPIO_writeMasked(LCD_DATA_PORT_ID,LCD_DATA_PINS_MASK,value);
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
-
-	_delay_ms(1); /* delay for processing Tdsw = 100ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1); /* delay for processing Th = 13ns */
+	_delay_us(LCD_E_PULSE_TIME_US); /* Tcyce = 500ns between two pulses */
+	GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
+	_delay_us(LCD_E_PULSE_TIME_US);
+	GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0, the LCD latches the nibble */
 
 #elif (LCD_DATA_BITS_MODE == 8)
-	GPIO_writePort(LCD_DATA_PORT_ID,command); /* out the required command to the data bus D0 --> D7 */
-	_delay_ms(1); /* delay for processing Tdsw = 100ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1); /* delay for processing Th = 13ns */
+	GPIO_WRITE_PORT(LCD_DATA_PORT_ID,value); /* out the required value to the data bus D0 --> D7 */
+	GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
+	_delay_us(LCD_E_PULSE_TIME_US);
+	GPIO_WRITE_PIN(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0, the LCD latches the byte */
 #endif
 }
 
+/* Queue one raw write for LCD_service, wait for a free entry if the queue is full */
+static void LCD_queueWrite(uint8 rs, uint8 value)
+{
+	uint8 next_head = (g_lcdQueueHead + 1) & (LCD_QUEUE_SIZE - 1);
+	while(next_head == g_lcdQueueTail); /* queue full, wait for LCD_service */
+	g_lcdQueue[g_lcdQueueHead] = ((uint16)rs << 8) | value;
+	g_lcdQueueHead = next_head;
+}
+
+/* Send one byte and wait the execution time if the busy flag can't be read */
+static void LCD_writeByte(uint8 rs, uint8 value)
+{
+	if(rs == LOGIC_LOW)
+	{
+		PROF_BEGIN(PROF_LCD_SEND_COMMAND);
+		LCD_write(LOGIC_LOW,value); /* Instruction Mode RS=0 */
+		PROF_END(PROF_LCD_SEND_COMMAND);
+	}
+	else
+	{
+		PROF_BEGIN(PROF_LCD_DISPLAY_CHARACTER);
+		LCD_write(LOGIC_HIGH,value); /* Data Mode RS=1 */
+		PROF_END(PROF_LCD_DISPLAY_CHARACTER);
+	}
+#if (LCD_USE_BUSY_FLAG == FALSE)
+	_delay_us(LCD_EXEC_TIME_US);
+#endif
+}
+
+/*
+ * Number of writes (characters and cursor commands) needed to turn the glass into the published frame,
+ * from the current glass or from a cleared glass.
+ */
+static uint8 LCD_flushCost(boolean from_clear)
+{
+	uint8 row,col,address,cost = 0;
+	uint8 lcd_address = from_clear ? 0 : g_lcdAddress;
+	for(row = 0; row < LCD_ROWS; row++)
+	{
+		address = LCD_rowAddress(row);
+		for(col = 0; col < LCD_COLS; col++,address++)
+		{
+			if(g_lcdFrame[row][col] != (from_clear ? ' ' : g_lcdScreen[row][col]))
+			{
+				cost += (lcd_address != address) ? 2 : 1;
+				lcd_address = address + 1;
+			}
+		}
+	}
+	return cost;
+}
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
 /*
  * Description :
- * Display the required character on the screen
+ * Initialize the LCD:
+ * 1. Setup the LCD pins directions by use the GPIO driver.
+ * 2. Setup the LCD Data Mode 4-bits or 8-bits.
  */
-void LCD_displayCharacter(uint8 data)
+void LCD_init(void)
 {
-	//uint8 lcd_port_value = 0;
-	GPIO_writePin(LCD_RS_PORT_ID,LCD_RS_PIN_ID,LOGIC_HIGH); /* Data Mode RS=1 */
-	GPIO_writePin(LCD_RW_PORT_ID,LCD_RW_PIN_ID,LOGIC_LOW); /* write data to LCD so RW=0 */
-	_delay_ms(1); /* delay for processing Tas = 50ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	_delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+	/* Configure the direction for RS, RW and E pins as output pins */
+	GPIO_SETUP_PIN_DIRECTION(LCD_RS_PORT_ID,LCD_RS_PIN_ID,PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(LCD_RW_PORT_ID,LCD_RW_PIN_ID,PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(LCD_E_PORT_ID,LCD_E_PIN_ID,PIN_OUTPUT);
+
+	_delay_ms(LCD_POWER_ON_TIME_MS); /* the LCD ignores everything until its internal reset is done */
 
 #if (LCD_DATA_BITS_MODE == 4)
-	/* out the last 4 bits of the required data to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
-#ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | (data & 0xF0);
-#else
-	lcd_port_value = (lcd_port_value & 0xF0) | ((data & 0xF0) >> 4);
-#endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	_delay_ms(1); /* delay for processing Tdsw = 100ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1); /* delay for processing Th = 13ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	_delay_ms(1); /* delay for processing Tpw - Tdws = 190ns */
+	/* Configure 4 pins in the data port as output pins */
+	GPIO_SETUP_PIN_DIRECTION(LCD_DATA_PORT_ID,LCD_FIRST_DATA_PIN_ID,PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(LCD_DATA_PORT_ID,(LCD_FIRST_DATA_PIN_ID+1),PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(LCD_DATA_PORT_ID,(LCD_FIRST_DATA_PIN_ID+2),PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION(LCD_DATA_PORT_ID,(LCD_FIRST_DATA_PIN_ID+3),PIN_OUTPUT);
 
-	/* out the first 4 bits of the required data to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
-#ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | ((data & 0x0F) << 4);
-#else
-	lcd_port_value = (lcd_port_value & 0xF0) | (data & 0x0F);
+	LCD_writeByte(LOGIC_LOW,LCD_GO_TO_HOME);
+#if (LCD_USE_BUSY_FLAG == FALSE)
+	_delay_ms(LCD_CLEAR_EXEC_TIME_MS);
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
-
-	_delay_ms(1); /* delay for processing Tdsw = 100ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1); /* delay for processing Th = 13ns */
+	LCD_writeByte(LOGIC_LOW,LCD_TWO_LINES_FOUR_BITS_MODE); /* use 2-line lcd + 4-bit Data Mode + 5*7 dot display Mode */
 
 #elif (LCD_DATA_BITS_MODE == 8)
-	GPIO_writePort(LCD_DATA_PORT_ID,data); /* out the required data to the data bus D0 --> D7 */
-	_delay_ms(1); /* delay for processing Tdsw = 100ns */
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1); /* delay for processing Th = 13ns */
+	/* Configure the data port as output port */
+	GPIO_SETUP_PORT_DIRECTION(LCD_DATA_PORT_ID,PORT_OUTPUT);
+	LCD_writeByte(LOGIC_LOW,LCD_TWO_LINES_EIGHT_BITS_MODE); /* use 2-line lcd + 8-bit Data Mode + 5*7 dot display Mode */
 #endif
+
+	LCD_writeByte(LOGIC_LOW,LCD_CURSOR_OFF); /* cursor off */
+	LCD_writeByte(LOGIC_LOW,LCD_CLEAR_COMMAND); /* clear LCD at the beginning */
+#if (LCD_USE_BUSY_FLAG == FALSE)
+	_delay_ms(LCD_CLEAR_EXEC_TIME_MS);
+#endif
+	LCD_resetGlass();
+	LCD_clearScreen(); /* the glass and the shadow are both blank now */
+
+	/* From now on the LCD is only driven by LCD_service */
+	g_lcdReady = TRUE;
 }
 
 /*
  * Description :
- * Display the required string on the screen
+ * Queue the required command for the screen, the shadow screen is not updated.
+ * Waits for a free entry if the queue is full, so the LCD_service tick must be running.
+ */
+void LCD_sendCommand(uint8 command)
+{
+	LCD_queueWrite(LOGIC_LOW,command); /* Instruction Mode RS=0 */
+}
+
+/*
+ * Description :
+ * Display the required character at the cursor position in the shadow screen
+ */
+void LCD_displayCharacter(uint8 data)
+{
+	/* characters past the end of the row are not visible, drop them */
+	if(g_lcdCursorCol < LCD_COLS)
+	{
+		g_lcdShadow[g_lcdCursorRow][g_lcdCursorCol] = data;
+		g_lcdCursorCol++;
+	}
+}
+
+/*
+ * Description :
+ * Display the required string at the cursor position in the shadow screen
  */
 void LCD_displayString(const char *Str)
 {
@@ -171,30 +329,52 @@ void LCD_displayString(const char *Str)
 
 /*
  * Description :
- * Move the cursor to a specified row and column index on the screen
+ * Display the required string stored in flash (PROGMEM) at the cursor position in the shadow screen
+ */
+void LCD_displayString_P(const char *Str)
+{
+	uint8 character;
+	while((character = pgm_read_byte(Str)) != '\0')
+	{
+		LCD_displayCharacter(character);
+		Str++;
+	}
+}
+
+/*
+ * Description :
+ * Clear the shadow screen and draw a layout stored in flash (PROGMEM), '\n' starts the next row.
+ * The cursor is left after the last character of the layout.
+ */
+void LCD_displayScreen_P(const char *Layout)
+{
+	uint8 character;
+	LCD_clearScreen();
+	while((character = pgm_read_byte(Layout)) != '\0')
+	{
+		if(character == '\n')
+		{
+			LCD_moveCursor(g_lcdCursorRow + 1,0);
+		}
+		else
+		{
+			LCD_displayCharacter(character);
+		}
+		Layout++;
+	}
+}
+
+/*
+ * Description :
+ * Move the cursor of the shadow screen to a specified row and column index
  */
 void LCD_moveCursor(uint8 row,uint8 col)
 {
-	uint8 lcd_memory_address;
-	
-	/* Calculate the required address in the LCD DDRAM */
-	switch(row)
+	if(row < LCD_ROWS)
 	{
-		case 0:
-			lcd_memory_address=col;
-				break;
-		case 1:
-			lcd_memory_address=col+0x40;
-				break;
-		case 2:
-			lcd_memory_address=col+0x10;
-				break;
-		case 3:
-			lcd_memory_address=col+0x50;
-				break;
-	}					
-	/* Move the LCD cursor to this specific address */
-	LCD_sendCommand(lcd_memory_address | LCD_SET_CURSOR_LOCATION);
+		g_lcdCursorRow = row;
+		g_lcdCursorCol = col;
+	}
 }
 
 /*
@@ -207,6 +387,89 @@ void LCD_displayStringRowColumn(uint8 row,uint8 col,const char *Str)
 	LCD_displayString(Str); /* display the string */
 }
 
+/*
+ * Description :
+ * Display the required string stored in flash (PROGMEM) in a specified row and column index on the screen
+ */
+void LCD_displayStringRowColumn_P(uint8 row,uint8 col,const char *Str)
+{
+	LCD_moveCursor(row,col); /* go to to the required LCD position */
+	LCD_displayString_P(Str); /* display the string */
+}
+
+/*
+ * Description :
+ * Return the character code of a custom glyph (LCD_GLYPH_HEIGHT rows stored in flash).
+ * The glyph is uploaded to CGRAM only the first time it is used, when the 8 slots are taken
+ * the oldest one is replaced and the cells still showing it change with it.
+ */
+uint8 LCD_loadGlyph(const uint8 *Glyph)
+{
+	uint8 slot,i;
+
+	/* cache hit */
+	for(slot = 0; slot < LCD_GLYPH_SLOTS; slot++)
+	{
+		if(g_lcdGlyphs[slot] == Glyph)
+		{
+			return slot;
+		}
+	}
+
+	/* first free slot, otherwise replace the oldest one */
+	for(slot = 0; (slot < LCD_GLYPH_SLOTS) && (g_lcdGlyphs[slot] != NULL_PTR); slot++);
+	if(slot == LCD_GLYPH_SLOTS)
+	{
+		slot = g_lcdGlyphNext;
+		g_lcdGlyphNext = (g_lcdGlyphNext + 1) & (LCD_GLYPH_SLOTS - 1);
+	}
+	g_lcdGlyphs[slot] = Glyph;
+
+	/* the upload is queued, so it reaches the LCD before the cells using the glyph */
+	LCD_queueWrite(LOGIC_LOW,LCD_SET_CGRAM_ADDRESS | (slot << 3));
+	for(i = 0; i < LCD_GLYPH_HEIGHT; i++)
+	{
+		LCD_queueWrite(LOGIC_HIGH,pgm_read_byte(&Glyph[i]));
+	}
+	return slot;
+}
+
+/*
+ * Description :
+ * Draw a horizontal progress bar of width cells showing value out of max in the shadow screen,
+ * with a resolution of one pixel column.
+ */
+void LCD_progressBar(uint8 row,uint8 col,uint8 width,uint8 value,uint8 max)
+{
+	uint16 pixels;
+	uint8 cell;
+
+	if(value > max)
+	{
+		value = max;
+	}
+	pixels = (max == 0) ? 0 : ((uint16)value * width * LCD_GLYPH_WIDTH) / max;
+
+	LCD_moveCursor(row,col);
+	for(cell = 0; cell < width; cell++)
+	{
+		if(pixels >= LCD_GLYPH_WIDTH)
+		{
+			LCD_displayCharacter(LCD_FULL_BLOCK_CHAR);
+			pixels -= LCD_GLYPH_WIDTH;
+		}
+		else if(pixels != 0)
+		{
+			LCD_displayCharacter(LCD_loadGlyph(g_lcdBarGlyphs[pixels - 1]));
+			pixels = 0;
+		}
+		else
+		{
+			LCD_displayCharacter(' ');
+		}
+	}
+}
+
 /*
  * Description :
  * Display the required decimal value on the screen
@@ -220,10 +483,135 @@ void LCD_intgerToString(int data)
 
 /*
  * Description :
- * Send the clear screen command
+ * Clear the shadow screen and move its cursor home
  */
 void LCD_clearScreen(void)
 {
-	LCD_sendCommand(LCD_CLEAR_COMMAND); /* Send clear display command */
+	uint8 row,col;
+	for(row = 0; row < LCD_ROWS; row++)
+	{
+		for(col = 0; col < LCD_COLS; col++)
+		{
+			g_lcdShadow[row][col] = ' ';
+		}
+	}
+	g_lcdCursorRow = 0;
+	g_lcdCursorCol = 0;
 }
 
+/*
+ * Description :
+ * Publish the shadow screen, LCD_service then draws the cells that differ from the glass in the background.
+ */
+void LCD_flush(void)
+{
+	uint8 row,col;
+	uint8 sreg = SREG;
+
+	/* LCD_service must not see a half copied frame */
+	cli();
+	for(row = 0; row < LCD_ROWS; row++)
+	{
+		for(col = 0; col < LCD_COLS; col++)
+		{
+			g_lcdFrame[row][col] = g_lcdShadow[row][col];
+		}
+	}
+	g_lcdNewFrame = TRUE;
+	g_lcdFramePending = TRUE;
+	SREG = sreg;
+}
+
+/*
+ * Description :
+ * Wait until all the queued commands are sent and the last published frame is on the glass.
+ */
+void LCD_sync(void)
+{
+	while((g_lcdQueueTail != g_lcdQueueHead) || g_lcdFramePending);
+}
+
+/*
+ * Description :
+ * Make at most LCD_SERVICE_BURST writes to the LCD: the queued commands first, then the cells
+ * of the published frame that differ from the glass. The controller address counter moves
+ * by itself after every character, so a cursor command is only sent to jump over the cells
+ * that did not change. When most of the glass must be blanked, clearing it first is cheaper.
+ * Must be called periodically from a timer interrupt, at least 2 ms apart so that a clear
+ * or return home is over before the next call.
+ */
+void LCD_service(void)
+{
+	uint8 budget = LCD_SERVICE_BURST;
+	uint8 address;
+	uint16 entry;
+
+	if(!g_lcdReady)
+	{
+		return;
+	}
+
+	PROF_BEGIN(PROF_LCD_SERVICE);
+	while(budget != 0)
+	{
+		if(g_lcdQueueTail != g_lcdQueueHead)
+		{
+			entry = g_lcdQueue[g_lcdQueueTail];
+			g_lcdQueueTail = (g_lcdQueueTail + 1) & (LCD_QUEUE_SIZE - 1);
+			LCD_writeByte((uint8)(entry >> 8),(uint8)entry);
+			g_lcdAddress = LCD_ADDRESS_UNKNOWN; /* a raw command may move the address counter */
+			budget--;
+			if(((entry >> 8) == LOGIC_LOW) && ((uint8)entry <= LCD_GO_TO_HOME))
+			{
+				break; /* slow instruction, leave the LCD alone until the next call */
+			}
+		}
+		else if(g_lcdNewFrame)
+		{
+			g_lcdNewFrame = FALSE;
+			g_lcdScanRow = 0;
+			g_lcdScanCol = 0;
+			if((LCD_CLEAR_COST + LCD_flushCost(TRUE)) < LCD_flushCost(FALSE))
+			{
+				LCD_writeByte(LOGIC_LOW,LCD_CLEAR_COMMAND);
+				LCD_resetGlass();
+				break; /* slow instruction, leave the LCD alone until the next call */
+			}
+		}
+		else if(g_lcdFramePending)
+		{
+			/* find the next cell that differs from the glass */
+			while((g_lcdScanRow < LCD_ROWS) &&
+					(g_lcdFrame[g_lcdScanRow][g_lcdScanCol] == g_lcdScreen[g_lcdScanRow][g_lcdScanCol]))
+			{
+				g_lcdScanCol++;
+				if(g_lcdScanCol == LCD_COLS)
+				{
+					g_lcdScanCol = 0;
+					g_lcdScanRow++;
+				}
+			}
+			if(g_lcdScanRow == LCD_ROWS)
+			{
+				g_lcdFramePending = FALSE; /* the frame is on the glass */
+				break;
+			}
+
+			/* a cell counts as one write even when it needs a cursor command */
+			address = LCD_rowAddress(g_lcdScanRow) + g_lcdScanCol;
+			if(g_lcdAddress != address)
+			{
+				LCD_writeByte(LOGIC_LOW,address | LCD_SET_CURSOR_LOCATION);
+			}
+			LCD_writeByte(LOGIC_HIGH,g_lcdFrame[g_lcdScanRow][g_lcdScanCol]);
+			g_lcdScreen[g_lcdScanRow][g_lcdScanCol] = g_lcdFrame[g_lcdScanRow][g_lcdScanCol];
+			g_lcdAddress = address + 1;
+			budget--;
+		}
+		else
+		{
+			break; /* nothing to send */
+		}
+	}
+	PROF_END(PROF_LCD_SERVICE);
+}
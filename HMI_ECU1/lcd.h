@@ -31,8 +31,23 @@
 #define LCD_FIRST_DATA_PIN_ID         PIN0_ID
 #endif
 
+/* The four data pins in the data port */
+#define LCD_DATA_PINS_MASK            (0x0F << LCD_FIRST_DATA_PIN_ID)
+
 #endif
 
+/*
+ * Set to TRUE to wait for the LCD by reading its busy flag through RW,
+ * FALSE for boards where RW is tied to ground: every write then waits the worst case execution time.
+ */
+#define LCD_USE_BUSY_FLAG              TRUE
+
+/* LCD timing */
+#define LCD_POWER_ON_TIME_MS           40   /* Vcc rise to the first instruction */
+#define LCD_E_PULSE_TIME_US            1    /* enable pulse width, 230ns min */
+#define LCD_EXEC_TIME_US               50   /* most instructions and data writes, 37us typical */
+#define LCD_CLEAR_EXEC_TIME_MS         2    /* clear and return home, 1.52ms typical */
+
 /* LCD HW Ports and Pins Ids */
 #define LCD_RS_PORT_ID                 PORTA_ID
 #define LCD_RS_PIN_ID                  PIN0_ID
@@ -45,6 +60,21 @@
 
 #define LCD_DATA_PORT_ID               PORTB_ID
 
+/* The busy flag is read on D7 */
+#if (LCD_DATA_BITS_MODE == 4)
+#define LCD_BUSY_FLAG_PIN_ID           (LCD_FIRST_DATA_PIN_ID+3)
+#else
+#define LCD_BUSY_FLAG_PIN_ID           PIN7_ID
+#endif
+
+/* LCD geometry: 2x16 or 4x20 (any 1..4 rows of up to 20 cols) */
+#define LCD_ROWS                       2
+#define LCD_COLS                       16
+
+/* Background drawing: writes made by every LCD_service call and raw commands queue size (power of two) */
+#define LCD_SERVICE_BURST              8
+#define LCD_QUEUE_SIZE                 16
+
 /* LCD Commands */
 #define LCD_CLEAR_COMMAND              0x01
 #define LCD_GO_TO_HOME                 0x02
@@ -53,7 +83,23 @@
 #define LCD_CURSOR_OFF                 0x0C
 #define LCD_CURSOR_ON                  0x0E
 #define LCD_SET_CURSOR_LOCATION        0x80
+#define LCD_SET_CGRAM_ADDRESS          0x40
+
+/* Custom glyphs: 8 CGRAM slots of 5x8 pixels, shown with the character codes 0 to 7 */
+#define LCD_GLYPH_SLOTS                8
+#define LCD_GLYPH_HEIGHT               8
+#define LCD_GLYPH_WIDTH                5
 
+/* Character of the LCD ROM with all the pixels on */
+#define LCD_FULL_BLOCK_CHAR            0xFF
+
+
+/*
+ * The application draws in a RAM shadow of the screen: LCD_displayCharacter, LCD_displayString,
+ * LCD_moveCursor and LCD_clearScreen only change the shadow. LCD_flush publishes the shadow and
+ * returns at once, LCD_service then sends from a timer interrupt the cells that differ from what
+ * is already on the glass, moving the LCD cursor only over the gaps. LCD_sync waits for the glass.
+ */
 
 /*
  * Description :
@@ -65,25 +111,39 @@ void LCD_init(void);
 
 /*
  * Description :
- * Send the required command to the screen
+ * Queue the required command for the screen, the shadow screen is not updated.
+ * Waits for a free entry if the queue is full, so the LCD_service tick must be running.
  */
 void LCD_sendCommand(uint8 command);
 
 /*
  * Description :
- * Display the required character on the screen
+ * Display the required character at the cursor position in the shadow screen
  */
 void LCD_displayCharacter(uint8 data);
 
 /*
  * Description :
- * Display the required string on the screen
+ * Display the required string at the cursor position in the shadow screen
  */
 void LCD_displayString(const char *Str);
 
 /*
  * Description :
- * Move the cursor to a specified row and column index on the screen
+ * Display the required string stored in flash (PROGMEM) at the cursor position in the shadow screen
+ */
+void LCD_displayString_P(const char *Str);
+
+/*
+ * Description :
+ * Clear the shadow screen and draw a layout stored in flash (PROGMEM), '\n' starts the next row.
+ * The cursor is left after the last character of the layout.
+ */
+void LCD_displayScreen_P(const char *Layout);
+
+/*
+ * Description :
+ * Move the cursor of the shadow screen to a specified row and column index
  */
 void LCD_moveCursor(uint8 row,uint8 col);
 
@@ -93,6 +153,27 @@ void LCD_moveCursor(uint8 row,uint8 col);
  */
 void LCD_displayStringRowColumn(uint8 row,uint8 col,const char *Str);
 
+/*
+ * Description :
+ * Display the required string stored in flash (PROGMEM) in a specified row and column index on the screen
+ */
+void LCD_displayStringRowColumn_P(uint8 row,uint8 col,const char *Str);
+
+/*
+ * Description :
+ * Return the character code of a custom glyph (LCD_GLYPH_HEIGHT rows stored in flash).
+ * The glyph is uploaded to CGRAM only the first time it is used, when the 8 slots are taken
+ * the oldest one is replaced and the cells still showing it change with it.
+ */
+uint8 LCD_loadGlyph(const uint8 *Glyph);
+
+/*
+ * Description :
+ * Draw a horizontal progress bar of width cells showing value out of max in the shadow screen,
+ * with a resolution of one pixel column.
+ */
+void LCD_progressBar(uint8 row,uint8 col,uint8 width,uint8 value,uint8 max);
+
 /*
  * Description :
  * Display the required decimal value on the screen
@@ -101,8 +182,27 @@ void LCD_intgerToString(int data);
 
 /*
  * Description :
- * Send the clear screen command
+ * Clear the shadow screen and move its cursor home
  */
 void LCD_clearScreen(void);
 
+/*
+ * Description :
+ * Publish the shadow screen, LCD_service then draws the cells that differ from the glass in the background.
+ */
+void LCD_flush(void);
+
+/*
+ * Description :
+ * Wait until all the queued commands are sent and the last published frame is on the glass.
+ */
+void LCD_sync(void);
+
+/*
+ * Description :
+ * Make at most LCD_SERVICE_BURST writes to the LCD: the queued commands first, then the changed cells.
+ * Must be called periodically from a timer interrupt, at least 2 ms apart.
+ */
+void LCD_service(void);
+
 #endif
@@ -7,152 +7,205 @@
 
 #include <avr/io.h>
 #include <util/delay.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
 #include "main.h"
 #include "uart.h"
 #include "lcd.h"
 #include "keypad.h"
 #include "timer.h"
-
-
+#include "profiler.h"
+#include "pin.h"
+#include "common_macros.h"
+
+
+
+/*******************************************************************************
+ *                  UI Strings and Screen Layouts (in flash)                   *
+ *******************************************************************************/
+
+/* Kept in flash so they are not copied to SRAM at startup, '\n' starts the second row */
+static const char g_welcomeScreen[]           PROGMEM = "    Welcome";
+static const char g_enterKeyHint[]            PROGMEM = "Use (=) as Enter";
+static const char g_newPasswordScreen[]       PROGMEM = "  New Password  ";
+static const char g_enterPasswordScreen[]     PROGMEM = "Enter Password\n";
+static const char g_reEnterPasswordScreen[]   PROGMEM = "ReEnter Password\n";
+static const char g_mismatchedScreen[]        PROGMEM = "MISMATCHED Pass";
+static const char g_mainOptionsScreen[]       PROGMEM = "(+): Open Door\n(-): Change Pass";
+static const char g_promptPasswordScreen[]    PROGMEM = "Enter Password :";
+static const char g_doorOpeningScreen[]       PROGMEM = "Door is Opening";
+static const char g_doorHoldScreen[]          PROGMEM = "Door is on Hold";
+static const char g_doorClosingScreen[]       PROGMEM = "Door is Closing";
+static const char g_wrongPasswordScreen[]     PROGMEM = " Wrong Password ";
+static const char g_lockedOutScreen[]         PROGMEM = "WARNING";
 
 /* Global array to store the password inputed from the user */
-uint8 g_inputPassword[PASSWORD_LENGTH];
+uint8 g_inputPassword[PIN_MAX_BYTES];
 
 /* Global Variable to store the status of the Password after comparing */
 uint8 g_matchStatus = PASS_MIS_MATCHED;
 
-/* Global Variable to keep track of the seconds counted by the timer */
-uint8 g_tick = 0;
+/* Token of the session opened by the last right password, NO_SESSION when there is none */
+uint16 g_sessionToken = NO_SESSION;
 
-/* Global Variable to keep track of how many times the user has inputed the password incorrectly */
-uint8 g_passwordMistakes = 0;
+/* Global Variable to keep track of the system ticks ( KEYPAD_SCAN_PERIOD_MS ), the clock of SLEEP_MS */
+volatile uint16 g_clock = 0;
 
 /* Global Variable to keep track of the command sent from the CONTROL MCU through UART */
 uint8 g_command;
 
+/*
+ * Coroutines of the UI: the UI flow runs the main options on g_menuPt,
+ * a command runs its reply sequence on g_commandPt, and the password input runs on g_stepPt.
+ */
+PT_Type g_uiPt;
+PT_Type g_menuPt;
+PT_Type g_commandPt;
+PT_Type g_stepPt;
+
+/* Values kept across the waits of the coroutines */
+uint8 g_menuKey;  /* Key of the running main option */
+uint8 g_reply;    /* Reply of the CONTROL MCU whose sequence is running */
+uint8 g_key;      /* Last key taken by the password input or the lockout screen */
+uint8 g_frame;    /* Last data byte received from the CONTROL MCU */
+uint8 g_digits;   /* Digits of the password typed so far */
+uint8 g_doorState;  /* Door state of the last DOOR_STATUS frame */
+uint8 g_doorPeriod; /* Seconds of the shown door phase, the first DOOR_STATUS frame of the phase gives them */
+uint16 g_lockoutRemaining; /* Seconds left of the lockout */
+uint16 g_lockoutLength;    /* Whole time of the lockout, the length of the bar */
+
+/*
+ * Main options in flash, indexed by ( key - MENU_FIRST_KEY ).
+ * A new option only needs its entry here, the other entries stay empty.
+ */
+static PT_THREAD((* const g_menuOptions[MENU_KEYS])(PT_Type *pt)) PROGMEM = {
+	[OPEN_DOOR_KEY - MENU_FIRST_KEY]       = HMI_openDoorOption,
+	[CHANGE_PASSWORD_KEY - MENU_FIRST_KEY] = HMI_changePasswordOption,
+#if PROF_ENABLE
+	[PROFILE_DUMP_KEY - MENU_FIRST_KEY]    = HMI_profileDumpOption,
+#endif
+};
+
+/* Screen sequences of the CONTROL MCU replies in flash, indexed by ( reply - CMD_FIRST ) */
+static PT_THREAD((* const g_replySequences[CMD_COUNT])(PT_Type *pt)) PROGMEM = {
+	[OPENING_DOOR - CMD_FIRST]      = HMI_openingDoor,
+	[CHANGING_PASSWORD - CMD_FIRST] = HMI_newPassword,
+	[WRONG_PASSWORD - CMD_FIRST]    = HMI_wrongPassword,
+	[LOCKED_OUT - CMD_FIRST]        = HMI_lockedOut,
+};
+
 
 int main(void)
 {
 
-	/* Variable to store the pressed key */
-	uint8 key_option;
 	/* Enable Global Interrupts */
 	SREG  |= ( 1 << 7 );
 
 	/* Initialize the UART with Configuration */
 	UART_ConfigType UART_Config = {9600,EIGHT_BITS, ONE_STOP_BIT,DISABLED};
 	UART_init(&UART_Config);
+#if PROF_ENABLE
+	/* Initialize the hot-path profiler */
+	PROF_init();
+#endif
+	/* Start the system tick that scans the keypad in the background */
+	HMI_startTickTimer();
+
 	/* Initialize LCD */
 	LCD_init();
-	LCD_moveCursor(0, 4);
-	LCD_displayString("Welcome");
-	LCD_moveCursor(1, 0);
-	_delay_ms(STAND_PRESENTATION_TIME);
-	LCD_displayString("Use (=) as Enter");
-	_delay_ms(STAND_PRESENTATION_TIME);
-	LCD_clearScreen();
-
-	/* Set the Password for the first time */
-	HMI_newPassword();
 
+	/* The UI flow waits without blocking, more coroutines can run beside it in this loop */
+	PT_INIT(&g_uiPt);
 	while(1)
 	{
+		HMI_uiFlow(&g_uiPt);
+	}
+}
 
-		/* Display the main options to the screen to make the user decide */
-		HMI_mainOptions();
-
-		/* Store which key has been pressed for later use */
-		key_option = KEYPAD_getPressedKey();
-
-		/* Depending on the pressed key, Perform some operation */
-		switch (key_option)
-		{
-
-		case OPEN_DOOR:
 
-			/* Ask the user to input a password */
-			HMI_promptPassword();
-			/* Ask CONTROL MCU to check the Password */
-			HMI_sendCommand(SEND_CHECK_PASSWORD);
-			/* Send the inputed password to the CONTROL MCU */
-			HMI_sendPassword(g_inputPassword);
-			/* Inform CONTROL MCU what the user has chosen */
-			HMI_sendCommand(OPEN_DOOR);
 
-			/* Receive the order command from CONTROL MCU */
-			g_matchStatus = HMI_receiveCommand();
+PT_THREAD(HMI_uiFlow(PT_Type *pt))
+{
+	PT_BEGIN(pt);
 
-			/* In case the two passwords matches */
-			if(g_matchStatus ==  OPENING_DOOR)
-			{
-				/* Begin unLocking and Locking the Door */
-				HMI_openingDoor();
-			}
-			/* In case the two passwords did not match */
-			else if(g_matchStatus == WRONG_PASSWORD)
-			{
-				/* Begin wrong operation protocol */
-				HMI_wrongPassword();
-			}
+	/* Ask the CONTROL MCU if a password is stored, after a reset the main options come at once */
+	HMI_sendCommand(BOOT_STATUS);
+	AWAIT_FRAME(pt, g_frame);
+	if(g_frame == NOT_PROVISIONED)
+	{
+		LCD_displayScreen_P(g_welcomeScreen);
+		LCD_flush();
+		SLEEP_MS(pt, STAND_PRESENTATION_TIME);
+		LCD_displayStringRowColumn_P(1, 0, g_enterKeyHint);
+		LCD_flush();
+		SLEEP_MS(pt, STAND_PRESENTATION_TIME);
+		LCD_clearScreen();
+
+		/* Set the Password for the first time */
+		PT_SPAWN(pt, &g_menuPt, HMI_newPassword(&g_menuPt));
+	}
 
-			break; /* End of open door case */
+#if PROF_ENABLE
+	/* Boot time: Timer1 counts cycles since PROF_init() just after the reset, saturated once it wrapped */
+	HMI_mainOptions();
+	LCD_sync();
+	PROF_record(PROF_BOOT_TO_MENU, BIT_IS_SET(TIFR,TOV1) ? 0xFFFF : TCNT1);
+#endif
 
-		case CHANGE_PASSWORD:
+	while(1)
+	{
+		/* Display the main options to the screen to make the user decide */
+		HMI_mainOptions();
 
-			/* Ask the user to input a password */
-			HMI_promptPassword();
-			/* Ask CONTROL MCU to check the Password */
-			HMI_sendCommand(SEND_CHECK_PASSWORD);
-			/* Send the inputed password to the CONTROL MCU */
-			HMI_sendPassword(g_inputPassword);
-			/* Inform CONTROL MCU what the user has chosen */
-			HMI_sendCommand(CHANGE_PASSWORD);
+		/* Run the option of the pressed key, it may have been typed ahead */
+		AWAIT_KEY(pt, g_menuKey);
+		PT_SPAWN(pt, &g_menuPt, HMI_dispatchKey(&g_menuPt, g_menuKey));
+	}
 
-			/* Receive the order command from CONTROL MCU */
-			g_matchStatus = HMI_receiveCommand();
+	PT_END(pt);
+}
 
-			/* In case the two passwords matches */
-			if(g_matchStatus ==  CHANGING_PASSWORD)
-			{
-				/* Set new password for MCU */
-				HMI_newPassword();
-			}
-			/* In case the two passwords did not match */
-			else if(g_matchStatus == WRONG_PASSWORD)
-			{
-				/* Begin wrong operation protocol */
-				HMI_wrongPassword();
-			}
+void HMI_tickProcessing(void)
+{
+	g_clock++;     /* Clock of the coroutines sleeps */
+	KEYPAD_scan(); /* Run the keypad debounce state machines */
+	LCD_service(); /* Draw the next changed cells on the LCD */
+}
 
-			break; /* End of change password case */
 
-		}
-	}
-}
 
-void HMI_TimerCallBackProcessing(void)
+uint16 HMI_clock(void)
 {
-	g_tick++;
+	uint16 ticks;
+	uint8 sreg = SREG;
+
+	/* Written by the tick interrupt, take it in one piece */
+	cli();
+	ticks = g_clock;
+	SREG = sreg;
+	return ticks;
 }
 
 
 
-void HMI_startTimer(void)
+void HMI_startTickTimer(void)
 {
-	/* Setup Timer Configuration */
-	TIMER_ConfigType TIMER_Config = { TIMER1,CTC_Mode, 0, F_CPU_1024, 7813 };
+	/* Setup Timer Configuration: 1 MHz / 8 = 125 KHz, 250 counts = 2 ms */
+	TIMER_ConfigType TIMER_Config = { TIMER0, CTC_Mode, 0, F_CPU_8, 249 };
 
 	/* Initialize the Timer */
 	Timer_init(&TIMER_Config);
 
 	/* Set Call Back function for the timer */
-	Timer_setCallBack(HMI_TimerCallBackProcessing, TIMER1);
+	Timer_setCallBack(HMI_tickProcessing, TIMER0);
 }
 
 
 
 void HMI_sendCommand(uint8 g_command)
 {
+	PROF_BEGIN(PROF_SEND_COMMAND);
+
 	/* Inform CONTROL MCU that you are to send */
 	UART_sendByte(READY_TO_SEND);
 
@@ -164,12 +217,16 @@ void HMI_sendCommand(uint8 g_command)
 
 	/* Wait until the CONTROL MCU receive the command */
 	while(UART_recieveByte() != RECEIVE_DONE);
+
+	PROF_END(PROF_SEND_COMMAND);
 }
 
 
 
 uint8 HMI_receiveCommand(void)
 {
+	PROF_BEGIN(PROF_RECEIVE_COMMAND);
+
 	/* Wait until the CONTROL MCU is ready to send */
 	while(UART_recieveByte() != READY_TO_SEND);
 
@@ -182,51 +239,195 @@ uint8 HMI_receiveCommand(void)
 	/* Inform the CONTROL MCU that the receive has been done successfully */
 	UART_sendByte(RECEIVE_DONE);
 
+	PROF_END(PROF_RECEIVE_COMMAND);
+
 	return g_command;
 }
 
 
 
-void HMI_newPassword(void)
+PT_THREAD(HMI_dispatchKey(PT_Type *pt, uint8 key))
+{
+	uint8 index = (uint8)(key - MENU_FIRST_KEY); /* Keys under MENU_FIRST_KEY wrap above MENU_KEYS */
+	PT_THREAD((*option)(PT_Type *pt));
+
+	if(index >= MENU_KEYS)
+	{
+		return PT_ENDED; /* Not an option key */
+	}
+
+	option = (PT_THREAD((*)(PT_Type *)))pgm_read_word(&g_menuOptions[index]);
+	if(option == NULL_PTR)
+	{
+		return PT_ENDED;
+	}
+	return (*option)(pt); /* The option runs on the same PT_Type, the key doesn't change until it ends */
+}
+
+
+
+PT_THREAD(HMI_dispatchReply(PT_Type *pt, uint8 reply))
+{
+	uint8 index = (uint8)(reply - CMD_FIRST); /* Codes under CMD_FIRST wrap above CMD_COUNT */
+	PT_THREAD((*sequence)(PT_Type *pt));
+
+	if(index >= CMD_COUNT)
+	{
+		return PT_ENDED; /* Not a command */
+	}
+
+	sequence = (PT_THREAD((*)(PT_Type *)))pgm_read_word(&g_replySequences[index]);
+	if(sequence == NULL_PTR)
+	{
+		return PT_ENDED;
+	}
+	return (*sequence)(pt); /* The sequence runs on the same PT_Type, the reply doesn't change until it ends */
+}
+
+
+
+PT_THREAD(HMI_sendAuthorizedCommand(PT_Type *pt, uint8 command))
+{
+	PT_BEGIN(pt);
+
+	if(g_sessionToken != NO_SESSION)
+	{
+		/* One frame in place of the prompt and the password check */
+		HMI_sendCommand(SESSION);
+		UART_sendByte((uint8)(g_sessionToken >> 8));
+		_delay_ms(SEND_RECEIVE_TIME);
+		UART_sendByte((uint8)g_sessionToken);
+		_delay_ms(SEND_RECEIVE_TIME);
+		UART_sendByte(command);
+		_delay_ms(SEND_RECEIVE_TIME);
+
+		PT_SPAWN(pt, &g_commandPt, HMI_awaitReply(&g_commandPt));
+		if(g_sessionToken != NO_SESSION)
+		{
+			PT_SPAWN(pt, &g_commandPt, HMI_dispatchReply(&g_commandPt, g_reply));
+			PT_EXIT(pt);
+		}
+		/* The session is over, fall back to the password */
+	}
+
+	/* Inform CONTROL MCU what the user has chosen, it checks the digits as they are typed */
+	HMI_sendCommand(command);
+	/* Ask the user to input a password, each digit is sent to the CONTROL MCU on its key press */
+	PT_SPAWN(pt, &g_commandPt, HMI_promptPassword(&g_commandPt));
+	if(g_digits == 0)
+	{
+		/* Given up: no reply comes, the CONTROL MCU drops the command at the next frame or at its own time out */
+		PT_EXIT(pt);
+	}
+
+	/* Receive the order command from CONTROL MCU and run its sequence */
+	PT_SPAWN(pt, &g_commandPt, HMI_awaitReply(&g_commandPt));
+	PT_SPAWN(pt, &g_commandPt, HMI_dispatchReply(&g_commandPt, g_reply));
+
+	PT_END(pt);
+}
+
+
+
+PT_THREAD(HMI_awaitReply(PT_Type *pt))
 {
+	PT_BEGIN(pt);
+
+	AWAIT_FRAME(pt, g_reply);
+
+	/* A right password opens a session: its token comes first, NO_SESSION when a session frame was refused */
+	if(g_reply == SESSION)
+	{
+		AWAIT_FRAME(pt, g_frame);
+		g_sessionToken = (uint16)g_frame << 8;
+		AWAIT_FRAME(pt, g_frame);
+		g_sessionToken |= g_frame;
+
+		if(g_sessionToken != NO_SESSION)
+		{
+			AWAIT_FRAME(pt, g_reply);
+		}
+	}
+
+	PT_END(pt);
+}
+
+
+
+PT_THREAD(HMI_openDoorOption(PT_Type *pt))
+{
+	return HMI_sendAuthorizedCommand(pt, OPEN_DOOR);
+}
+
+
+
+PT_THREAD(HMI_changePasswordOption(PT_Type *pt))
+{
+	return HMI_sendAuthorizedCommand(pt, CHANGE_PASSWORD);
+}
+
+
+
+#if PROF_ENABLE
+PT_THREAD(HMI_profileDumpOption(PT_Type *pt))
+{
+	/* Done in one call, the dumps are not cut by the other coroutines */
+	(void)pt;
+
+	/* Ask CONTROL MCU to dump its profiler table and skip it on this side */
+	HMI_sendCommand(PROFILE_DUMP);
+	PROF_discardFrame();
+	/* Dump the profiler table of this MCU, CONTROL MCU skips it on its side */
+	PROF_dump();
+	return PT_ENDED;
+}
+#endif
+
+
+
+PT_THREAD(HMI_newPassword(PT_Type *pt))
+{
+	PT_BEGIN(pt);
+
+	/* The CONTROL MCU closes the session when the password changes */
+	g_sessionToken = NO_SESSION;
+
 	/* Set its status at first as mis-matched */
 	g_matchStatus = PASS_MIS_MATCHED;
 
 	/* Loop until the HMI MCU get the same password */
 	while(g_matchStatus == PASS_MIS_MATCHED)
 	{
-		LCD_clearScreen(); /* Clear Screen */
-		LCD_displayString("  New Password  "); /* Inform the user that he will input new password */
-		_delay_ms(STAND_PRESENTATION_TIME); /* Hold for Presentation Time */
+		LCD_displayScreen_P(g_newPasswordScreen); /* Inform the user that he will input new password */
+		LCD_flush(); /* Show the screen */
+		SLEEP_MS(pt, STAND_PRESENTATION_TIME); /* Hold for Presentation Time */
 
-		LCD_clearScreen(); /* Clear Screen */
-		LCD_displayString("Enter Password"); /* Prompt the user to input the password for the first time */
-		LCD_moveCursor(1,0); /* Move Cursor to the second line */
-		HMI_getPassword(g_inputPassword); /* Get the password from the user */
+		LCD_displayScreen_P(g_enterPasswordScreen); /* Prompt the user to input the password for the first time */
+		PT_SPAWN(pt, &g_stepPt, HMI_getPassword(&g_stepPt, g_inputPassword, FALSE)); /* Get the password from the user */
 
 		HMI_sendCommand(SEND_FIRST_PASSWORD); /* Inform the CONTROL MCU that you will send the first password */
 		HMI_sendPassword(g_inputPassword); /* Send the password to the CONTROL MCU */
 
 
-		LCD_clearScreen(); /* Clear Screen */
-		LCD_displayString("ReEnter Password"); /* Prompt the user to input the password for the second time */
-		LCD_moveCursor(1,0); /* Move Cursor to the second line */
-		HMI_getPassword(g_inputPassword); /* Get the password from the user */
+		LCD_displayScreen_P(g_reEnterPasswordScreen); /* Prompt the user to input the password for the second time */
+		PT_SPAWN(pt, &g_stepPt, HMI_getPassword(&g_stepPt, g_inputPassword, FALSE)); /* Get the password from the user */
 
 		HMI_sendCommand(SEND_SECOND_PASSWORD); /* Inform the CONTROL MCU that you will send the second password */
 		HMI_sendPassword(g_inputPassword); /* Send the password to the CONTROL MCU */
 
 		/* Wait until the is able to send the confirmation of the second password */
-		g_matchStatus = HMI_receiveCommand();
+		AWAIT_FRAME(pt, g_matchStatus);
 
 		/* In case the Two Passwords did not match */
 		if (g_matchStatus == PASS_MIS_MATCHED)
 		{
-			LCD_clearScreen(); /* Clear Screen */
-			LCD_displayString("MISMATCHED Pass"); /* Display an Error Message */
-			_delay_ms(STAND_PRESENTATION_TIME); /* Hold for Presentation Time */
+			LCD_displayScreen_P(g_mismatchedScreen); /* Display an Error Message */
+			LCD_flush(); /* Show the screen */
+			SLEEP_MS(pt, STAND_PRESENTATION_TIME); /* Hold for Presentation Time */
 		}
 	}
+
+	PT_END(pt);
 }
 
 
@@ -234,9 +435,10 @@ void HMI_newPassword(void)
 void HMI_sendPassword(uint8 a_inputPassword[])
 {
 	uint8 counter;
+	uint8 size = PIN_getSize(a_inputPassword);
 
-	/* Loop on the passwords elements */
-	for( counter = 0; counter < PASSWORD_LENGTH; counter++)
+	/* Loop on the packed bytes, the CONTROL MCU takes the size from the first one */
+	for( counter = 0; counter < size; counter++)
 	{
 		UART_sendByte(a_inputPassword[counter]); /* Send Password element by element to the CONTROL MCU */
 		_delay_ms(SEND_RECEIVE_TIME);      /* Delay for the time gap for sending receiving time between the MCUs */
@@ -245,102 +447,226 @@ void HMI_sendPassword(uint8 a_inputPassword[])
 
 
 
-void HMI_getPassword(uint8 a_inputPassword[])
+PT_THREAD(HMI_getPassword(PT_Type *pt, uint8 a_inputPassword[], boolean stream))
 {
+	PT_BEGIN(pt);
+
 	LCD_moveCursor(1, 0);
+	LCD_flush(); /* Show the prompt */
 
-	uint8 counter = 0;
-	uint8 password_key = 0; /* Variable to store the pressed key */
+	g_digits = 0;
 
-	/* Stop getting number after you get 5 characters */
-	while( counter != PASSWORD_LENGTH )
+	/* Take digits until the user press (=) with at least PIN_MIN_DIGITS of them, PIN_MAX_DIGITS fill the LCD row */
+	while(1)
 	{
-		password_key = KEYPAD_getPressedKey(); /* Get the get the key pressed and store it in the password array */
+		/* Get the get the key pressed and store it in the password array, a streamed password gives up after DIGIT_TIMEOUT */
+		g_key = NO_KEY;
+		pt->wake = HMI_clock() + (uint16)(DIGIT_TIMEOUT * 1000UL / HMI_TICK_MS);
+		PT_WAIT_UNTIL(pt, KEYPAD_getKey(&g_key) || (stream && ((sint16)(HMI_clock() - pt->wake) >= 0)));
+		if(g_key == NO_KEY)
+		{
+			g_digits = 0; /* No password */
+			LCD_clearScreen();
+			PT_EXIT(pt);
+		}
 
-		if ( (password_key >= 0) && (password_key <= 9) )
+		/* The keypad is debounced in the background, every press is taken as soon as it happens */
+		if ( (g_key >= 0) && (g_key <= 9) && (g_digits < PIN_MAX_DIGITS) )
 		{
+			if(stream)
+			{
+				UART_sendByte(g_key); /* The CONTROL MCU waits for it, no time gap needed */
+			}
 			LCD_displayCharacter('*'); /* Display asterisk for privacy */
-			a_inputPassword[counter] = password_key;
-			counter++;
+			LCD_flush(); /* Only the new asterisk is sent */
+			PIN_setDigit(a_inputPassword, g_digits, g_key);
+			g_digits++;
+		}
+		else if ( (g_key == '=') && (g_digits >= PIN_MIN_DIGITS) )
+		{
+			if(stream)
+			{
+				UART_sendByte(PIN_STREAM_END); /* The CONTROL MCU answers at once */
+#if PROF_ENABLE
+				/* HMI share of the keypress to motor start latency, from the scan that debounced the (=) press */
+				PROF_record(PROF_KEY_TO_STREAM_END, (uint16)(TCNT1 - KEYPAD_getEventTime()));
+#endif
+			}
+			break;
 		}
-		_delay_ms(KEYPAD_CLICK_TIME); /* Delay time for keypad press */
 	} /* End while loop */
 
-	/* Don't leave until the user press (=) symbol */
-	while ( KEYPAD_getPressedKey() != '=' );
+	PIN_setLength(a_inputPassword, g_digits);
+
+	PT_END(pt);
 }
 
 
 
 void HMI_mainOptions(void)
 {
-	LCD_clearScreen(); /* Clear Screen */
-	LCD_displayString("(+): Open Door"); /* Display the first option */
-	LCD_moveCursor(1,0); /* Move to the next line */
-	LCD_displayString("(-): Change Pass"); /* Display the second option */
+	LCD_displayScreen_P(g_mainOptionsScreen); /* Display the two options */
+	LCD_flush(); /* Nothing is sent if the options are already on the screen */
 }
 
-void HMI_promptPassword(void)
+PT_THREAD(HMI_promptPassword(PT_Type *pt))
 {
-	LCD_clearScreen(); /* Clear Screen */
-	LCD_displayString("Enter Password :"); /* Prompt the user to write the password */
-	HMI_getPassword(g_inputPassword); /* Takes the password and store it in an array */
+	PT_BEGIN(pt);
+
+	LCD_displayScreen_P(g_promptPasswordScreen); /* Prompt the user to write the password */
+	PT_SPAWN(pt, &g_stepPt, HMI_getPassword(&g_stepPt, g_inputPassword, TRUE)); /* Takes the password and send it digit by digit */
+
+	PT_END(pt);
 }
 
 
-void HMI_openingDoor(void)
+PT_THREAD(HMI_openingDoor(PT_Type *pt))
 {
-	HMI_startTimer(); /* Start the timer to measure time period */
-
-	/* Open the door for ( 15 sec ) */
-	LCD_clearScreen(); /* Clear Screen */
-	LCD_displayString("Door is Opening"); /* Display explanation message on LCD */
-	while(g_tick < OPEN_DOOR_TIME); /* Count up to 15 */
-    g_tick = 0; /* Reset counter to reuse it */
-
-	/* Hold the door for ( 3 sec ) */
-	LCD_clearScreen(); /* Clear Screen */
-	LCD_displayString("Door is on Hold"); /* Display explanation message on LCD */
-	while(g_tick < HOLD_DOOR_TIME); /* Count up to 3 */
-    g_tick = 0; /* Reset counter to reuse it */
-
-	/* Open the door for ( 15 sec ) */
-	LCD_clearScreen(); /* Clear Screen */
-	LCD_displayString("Door is Closing"); /* Display explanation message on LCD */
-	while(g_tick < CLOSE_DOOR_TIME); /* Count up to 15 */
-    g_tick = 0; /* Reset counter to reuse it */
-
-    Timer_DeInit(TIMER1); /* Stop the timer */
+	PT_BEGIN(pt);
+
+	/* The CONTROL MCU times the door, the screens follow its DOOR_STATUS frames until the door is idle */
+	g_doorState = DOOR_IDLE;
+	do
+	{
+		AWAIT_FRAME(pt, g_frame);
+		if(g_frame == DOOR_STATUS)
+		{
+			AWAIT_FRAME(pt, g_frame);
+
+			/* A new phase shows its screen, its first frame gives the seconds of the whole phase */
+			if((g_frame >> DOOR_PHASE_STATE_SHIFT) != g_doorState)
+			{
+				g_doorState = g_frame >> DOOR_PHASE_STATE_SHIFT;
+				g_doorPeriod = g_frame & DOOR_PHASE_SECONDS_MASK;
+
+				if(g_doorState == DOOR_OPENING)
+				{
+					LCD_displayScreen_P(g_doorOpeningScreen); /* Display explanation message on LCD */
+				}
+				else if(g_doorState == DOOR_HOLD)
+				{
+					LCD_displayScreen_P(g_doorHoldScreen); /* Display explanation message on LCD */
+				}
+				else if(g_doorState == DOOR_CLOSING)
+				{
+					LCD_displayScreen_P(g_doorClosingScreen); /* Display explanation message on LCD */
+				}
+			}
+
+			if(g_doorState != DOOR_IDLE)
+			{
+				HMI_showCountdown(g_frame & DOOR_PHASE_SECONDS_MASK, g_doorPeriod);
+			}
+		}
+	} while(g_doorState != DOOR_IDLE);
+
     LCD_clearScreen(); /* Clear Screen */
+
+	PT_END(pt);
 }
 
 
 
 
-void HMI_wrongPassword(void)
+void HMI_showCountdown(uint16 remaining, uint16 period)
 {
-	g_passwordMistakes++; /* Increment the wrong counter */
+	uint16 elapsed = period - remaining;
+	uint8 shown = remaining;
+	uint8 unit = 's';
 
-	LCD_clearScreen(); /* Clear Screen */
-	LCD_displayString(" Wrong Password "); /* Display explanation message on LCD */
-	_delay_ms(STAND_PRESENTATION_TIME); /* Hold for Presentation Time */
+	/* Past 99 seconds the minutes left are shown, rounded up */
+	if(remaining >= 100)
+	{
+		shown = (remaining + 59) / 60;
+		unit = 'm';
+	}
 
-	/* If the user entered the password 3 times wrong */
-	if(g_passwordMistakes == MAX_NUM_OF_MISTAKES)
+	/* The bar takes 8 bits values, long periods are scaled down */
+	while(period > 0xFF)
 	{
-		HMI_startTimer(); /* Start the timer to measure time period */
+		period >>= 1;
+		elapsed >>= 1;
+	}
 
-		LCD_clearScreen(); /* Clear Screen */
-		LCD_displayString(" WARNING "); /* Display warning message on LCD */
+	/* The flush sends only the changed digits and bar cells */
+	LCD_moveCursor(1,0);
+	LCD_displayCharacter((shown >= 10) ? ('0' + shown / 10) : ' ');
+	LCD_displayCharacter('0' + shown % 10);
+	LCD_displayCharacter(unit);
+	LCD_progressBar(1,COUNTDOWN_BAR_COL,COUNTDOWN_BAR_WIDTH,elapsed,period);
+	LCD_flush();
+}
 
-		while(g_tick != WARNING_TIME); /* Display the message for one minute */
 
-		/* Reset the counters */
-		g_passwordMistakes = 0;
-		g_tick = 0;
 
-	    Timer_DeInit(TIMER1); /* Stop the timer */
+
+PT_THREAD(HMI_wrongPassword(PT_Type *pt))
+{
+	PT_BEGIN(pt);
+
+	/* The CONTROL MCU counts the mistakes, it answers LOCKED_OUT when the lockout starts */
+	LCD_displayScreen_P(g_wrongPasswordScreen); /* Display explanation message on LCD */
+	LCD_flush(); /* Show the screen */
+	SLEEP_MS(pt, STAND_PRESENTATION_TIME); /* Hold for Presentation Time */
+
+    LCD_clearScreen(); /* Clear Screen */
+
+	PT_END(pt);
+}
+
+
+
+PT_THREAD(HMI_lockedOut(PT_Type *pt))
+{
+	PT_BEGIN(pt);
+
+	/* The CONTROL MCU owns the lockout, ask it for the time left and the whole time of the bar */
+	HMI_sendCommand(LOCKOUT_STATUS);
+	AWAIT_FRAME(pt, g_frame);
+	g_lockoutRemaining = (uint16)g_frame << 8;
+	AWAIT_FRAME(pt, g_frame);
+	g_lockoutRemaining |= g_frame;
+	AWAIT_FRAME(pt, g_frame);
+	g_lockoutLength = (uint16)g_frame << 8;
+	AWAIT_FRAME(pt, g_frame);
+	g_lockoutLength |= g_frame;
+	if(g_lockoutLength < g_lockoutRemaining)
+	{
+		g_lockoutLength = g_lockoutRemaining;
+	}
+
+	/* Keys typed before the lockout must not be replayed as a new password */
+	KEYPAD_flush();
+
+	LCD_displayScreen_P(g_lockedOutScreen); /* Display warning message on LCD */
+
+	/* The seconds are counted on the system tick, one after the other so they don't drift */
+	pt->wake = HMI_clock();
+
+	while(g_lockoutRemaining != 0)
+	{
+		/* Show the time left as mm:ss on the first row, the countdown and its bar on the second one */
+		LCD_moveCursor(0,11);
+		LCD_displayCharacter('0' + (g_lockoutRemaining / 60) / 10);
+		LCD_displayCharacter('0' + (g_lockoutRemaining / 60) % 10);
+		LCD_displayCharacter(':');
+		LCD_displayCharacter('0' + (g_lockoutRemaining % 60) / 10);
+		LCD_displayCharacter('0' + (g_lockoutRemaining % 60) % 10);
+		HMI_showCountdown(g_lockoutRemaining, g_lockoutLength);
+
+		/* The keypad stays live: a key press leaves the screen, the lockout goes on in the CONTROL MCU */
+		g_key = NO_KEY;
+		pt->wake += 1000 / HMI_TICK_MS;
+		PT_WAIT_UNTIL(pt, KEYPAD_getKey(&g_key) || ((sint16)(HMI_clock() - pt->wake) >= 0));
+		if(g_key != NO_KEY)
+		{
+			break;
+		}
+
+		g_lockoutRemaining--;
 	}
 
     LCD_clearScreen(); /* Clear Screen */
+
+	PT_END(pt);
 }
@@ -10,48 +10,108 @@
 
 
 #include "std_types.h"
+#include "pt.h"
 
 
 #define OPENING_DOOR          			0xF0
 #define WRONG_PASSWORD        			0xF1
 #define CHANGING_PASSWORD     			0xF2
-#define OPEN_DOOR             			'+'
-#define CHANGE_PASSWORD       			'-'
 #define READY_TO_SEND         			0xF3
 #define READY_TO_RECEIVE      			0xF4
 #define RECEIVE_DONE          			0xF5
 #define SEND_FIRST_PASSWORD   			0xF6
 #define SEND_SECOND_PASSWORD 			0xF7
-#define SEND_CHECK_PASSWORD   			0xF8
+#define LOCKOUT_STATUS        			0xF8	/* Answered with the lockout seconds left then the whole lockout time, high bytes first */
+#define PROFILE_DUMP          			0xF9
+#define DOOR_STATUS           			0xFA	/* Followed by the DOOR_PHASE of the door sequence, sent by the CONTROL MCU while it runs */
+#define OPEN_DOOR             			0xFB	/* Followed by the password */
+#define CHANGE_PASSWORD       			0xFC	/* Followed by the password */
+#define BOOT_STATUS           			0xFD	/* Answered with PROVISIONED or NOT_PROVISIONED */
+#define LOCKED_OUT            			0xFE	/* Answer to a password sent while the lockout runs */
+#define SESSION               			0xFF	/* Followed by the session token and a command needing the password */
+
+/* Definitions for the command dispatch: the commands are the codes CMD_FIRST to 0xFF */
+#define CMD_FIRST             			0xF0
+#define CMD_COUNT             			16
+
+/* Keys of the main options, the menu table covers the keys MENU_FIRST_KEY to MENU_FIRST_KEY + MENU_KEYS - 1 */
+#define PROFILE_DUMP_KEY      			'*'
+#define OPEN_DOOR_KEY         			'+'
+#define CHANGE_PASSWORD_KEY   			'-'
+#define MENU_FIRST_KEY        			'*'
+#define MENU_KEYS             			4
 
 /* Definitions for Password */
-#define PASSWORD_LENGTH         		5
-#define MAX_NUM_OF_MISTAKES     		3
 #define PASS_MIS_MATCHED              	0
 #define PASS_MATCHED				  	1
 
+/*
+ * Definitions for the session: after a right password the CONTROL MCU sends SESSION then a token,
+ * the token stands for the password until the CONTROL MCU answers a SESSION frame with NO_SESSION
+ */
+#define NO_SESSION              		0x0000
+
+/* Answers of BOOT_STATUS, the password setup is only run when NOT_PROVISIONED */
+#define NOT_PROVISIONED         		0
+#define PROVISIONED             		1
+
 /* Definitions for Time Periods */
 #define SEND_RECEIVE_TIME      			10
 #define STAND_PRESENTATION_TIME         1500
-#define KEYPAD_CLICK_TIME         		500
-#define OPEN_DOOR_TIME      			15
-#define HOLD_DOOR_TIME       			3
-#define CLOSE_DOOR_TIME      			15
-#define WARNING_TIME           			60
+
+/* Seconds the user has for each digit of a streamed password, shorter than the DIGIT_TIMEOUT of the CONTROL MCU */
+#define DIGIT_TIMEOUT                   20
+
+/* Period of the system tick, the clock of SLEEP_MS */
+#define HMI_TICK_MS                     2
+
+/* Not a key of the keypad */
+#define NO_KEY                          0xFF
+
+/*
+ * Waits of the UI coroutines, they give the processor back until:
+ * AWAIT_KEY    a key is pressed, its key is written in key
+ * AWAIT_FRAME  the CONTROL MCU sends a command, it is written in frame
+ * SLEEP_MS     the time is over, up to 65 s
+ */
+#define AWAIT_KEY(pt, key)              PT_WAIT_UNTIL(pt, KEYPAD_getKey(&(key)))
+#define AWAIT_FRAME(pt, frame)          do{ PT_WAIT_UNTIL(pt, UART_isByteReceived()); (frame) = HMI_receiveCommand(); }while(0)
+#define SLEEP_MS(pt, ms)                PT_SLEEP(pt, HMI_clock(), (ms) / HMI_TICK_MS)
+
+/* States of the door sequence of the CONTROL MCU, in the order of its CONTROL_DoorState */
+typedef enum
+{
+	DOOR_IDLE, DOOR_OPENING, DOOR_HOLD, DOOR_CLOSING
+}HMI_DoorState;
+
+/* Phase of the door sequence in one byte: the door state, then the seconds left before its time out */
+#define DOOR_PHASE_STATE_SHIFT 			6
+#define DOOR_PHASE_SECONDS_MASK			0x3F
+
+/* Countdown screen: seconds left on the second row, then the progress bar */
+#define COUNTDOWN_BAR_COL               4
+#define COUNTDOWN_BAR_WIDTH             12
 
 
 
 /*
  * Description:
- * Function to set the call back function for the Interrupt to be executed
+ * Call back function of the system tick, runs every KEYPAD_SCAN_PERIOD_MS to scan the keypad
+ * and draw the changed cells of the LCD
  */
-void HMI_TimerCallBackProcessing(void);
+void HMI_tickProcessing(void);
 
 /*
  * Description:
- * Function to initialize Timer to operate depending on specific configuration
+ * Return the system ticks counted since the reset, it wraps every 131 s
  */
-void HMI_startTimer(void);
+uint16 HMI_clock(void);
+
+/*
+ * Description:
+ * Function to start the system tick on TIMER0
+ */
+void HMI_startTickTimer(void);
 
 /*
  * Description:
@@ -66,11 +126,61 @@ void HMI_sendCommand(uint8 g_command);
  */
 uint8 HMI_receiveCommand(void);
 
+/*
+ * Description:
+ * Coroutine of the whole UI: the first password setup after the BOOT_STATUS exchange, then the main options
+ */
+PT_THREAD(HMI_uiFlow(PT_Type *pt));
+
+/*
+ * Description:
+ * Coroutine running the option of a main options key from the menu table, other keys are ignored
+ */
+PT_THREAD(HMI_dispatchKey(PT_Type *pt, uint8 key));
+
+/*
+ * Description:
+ * Coroutine running the screen sequence of a reply of the CONTROL MCU from the reply table, other replies are ignored
+ */
+PT_THREAD(HMI_dispatchReply(PT_Type *pt, uint8 reply));
+
+/*
+ * Description:
+ * Send a command that needs the password to the CONTROL MCU and run the sequence of its reply,
+ * the session token is sent alone if there is one, the password is prompted otherwise
+ */
+PT_THREAD(HMI_sendAuthorizedCommand(PT_Type *pt, uint8 command));
+
+/*
+ * Description:
+ * Wait for the reply of the CONTROL MCU to a command and keep it in g_reply.
+ * A SESSION before it brings a new token, or NO_SESSION when the session is over and no reply follows
+ */
+PT_THREAD(HMI_awaitReply(PT_Type *pt));
+
+/*
+ * Description:
+ * Main option: open the door
+ */
+PT_THREAD(HMI_openDoorOption(PT_Type *pt));
+
+/*
+ * Description:
+ * Main option: change the password
+ */
+PT_THREAD(HMI_changePasswordOption(PT_Type *pt));
+
+/*
+ * Description:
+ * Main option: dump the profiler tables of both MCUs
+ */
+PT_THREAD(HMI_profileDumpOption(PT_Type *pt));
+
 /*
  * Description:
  * Function to set a new Password
  */
-void HMI_newPassword(void);
+PT_THREAD(HMI_newPassword(PT_Type *pt));
 
 /*
  * Description:
@@ -84,8 +194,10 @@ void HMI_sendPassword(uint8 a_inputPassword[]);
  * Function that takes Password from Keypad
  * and Store it in array for later use
  * and Display asterisk on the screen
+ * With stream set, every digit is also sent to the CONTROL MCU on its key press, then PIN_STREAM_END on (=),
+ * and the input ends without a password ( no digits ) after DIGIT_TIMEOUT seconds without a key
  */
-void HMI_getPassword(uint8 a_inputPassword[]);
+PT_THREAD(HMI_getPassword(PT_Type *pt, uint8 a_inputPassword[], boolean stream));
 
 /*
  * Description:
@@ -95,21 +207,34 @@ void HMI_mainOptions(void);
 
 /*
  * Description:
- * Prompt the user to input a password
+ * Prompt the user to input a password and stream it to the CONTROL MCU
+ */
+PT_THREAD(HMI_promptPassword(PT_Type *pt));
+
+/*
+ * Description:
+ * Function that explain door phase on the screen, following the DOOR_STATUS frames of the CONTROL MCU
  */
-void HMI_promptPassword(void);
+PT_THREAD(HMI_openingDoor(PT_Type *pt));
 
 /*
  * Description:
- * Function that explain door phase on the screen
+ * Show the seconds left of a phase ( the minutes from 100 seconds ) and a progress bar on the second row
  */
-void HMI_openingDoor(void);
+void HMI_showCountdown(uint16 remaining, uint16 period);
 
 /*
  * Description:
  * Function that take care of wrong password scenarios
  */
-void HMI_wrongPassword(void);
+PT_THREAD(HMI_wrongPassword(PT_Type *pt));
+
+/*
+ * Description:
+ * Show the lockout time left kept by the CONTROL MCU and count it down,
+ * a key press goes back to the main options before the end
+ */
+PT_THREAD(HMI_lockedOut(PT_Type *pt));
 
 
 #endif /* HMI_MCU_H_ */
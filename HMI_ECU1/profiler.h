@@ -0,0 +1,114 @@
+/*
+ * profiler.h
+ * Description: Header file for the hot-path cycle profiler
+ *
+ * Every probe site owns one entry in an SRAM table holding its call count,
+ * total, minimum and maximum cycles. The counts are taken from Timer1 running
+ * free at F_CPU, so the longest measurable interval is 65535 cycles.
+ * The table is sent over UART as a compact binary frame by PROF_dump()
+ * and turned into a latency report on the host by Tools/prof_report.py
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Set to 1 to compile the probes in, with 0 every probe expands to nothing */
+#ifndef PROF_ENABLE
+#define PROF_ENABLE                    0
+#endif
+
+/* Identifies this MCU inside the dump frame */
+#define PROF_MCU_ID                    'H'
+
+/* Dump frame layout: sync bytes, MCU id, number of probes, probe records, checksum */
+#define PROF_FRAME_SYNC1               0xA5
+#define PROF_FRAME_SYNC2               0x5A
+#define PROF_RECORD_SIZE               10
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/* Probe sites of this MCU, keep the order in sync with Tools/prof_report.py */
+typedef enum
+{
+	PROF_LCD_SEND_COMMAND, PROF_LCD_DISPLAY_CHARACTER, PROF_KEYPAD_SCAN, PROF_SEND_COMMAND, PROF_RECEIVE_COMMAND,
+	PROF_LCD_SERVICE, PROF_BOOT_TO_MENU, PROF_KEY_TO_STREAM_END,
+	PROF_NUM_OF_PROBES
+}PROF_ProbeId;
+
+typedef struct
+{
+	uint16 calls;
+	uint32 total_cycles;
+	uint16 min_cycles;
+	uint16 max_cycles;
+}PROF_RecordType;
+
+/*******************************************************************************
+ *                              Probe Macros                                   *
+ *******************************************************************************/
+#if PROF_ENABLE
+
+#include <avr/io.h> /* To read the TCNT1 Register */
+
+/* Take the start time stamp of the probe, must be in the same block as PROF_END */
+#define PROF_BEGIN(probe_id)           uint16 prof_start_##probe_id = TCNT1
+
+/* Take the end time stamp of the probe and accumulate it in the probe record */
+#define PROF_END(probe_id)             PROF_record((probe_id), (uint16)(TCNT1 - prof_start_##probe_id))
+
+#else
+
+#define PROF_BEGIN(probe_id)
+#define PROF_END(probe_id)
+
+#endif
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+#if PROF_ENABLE
+
+/*
+ * Description :
+ * Start Timer1 free running at F_CPU, measure the cost of an empty probe
+ * and clear all the probe records.
+ */
+void PROF_init(void);
+
+/*
+ * Description :
+ * Clear all the probe records.
+ */
+void PROF_reset(void);
+
+/*
+ * Description :
+ * Accumulate one measured interval in the record of the required probe.
+ * Samples taken while the application has Timer1 in another configuration are dropped,
+ * if the application stopped Timer1 the profiler takes it back.
+ */
+void PROF_record(PROF_ProbeId probe_id, uint16 cycles);
+
+/*
+ * Description :
+ * Send the probe records table as one binary frame through UART.
+ */
+void PROF_dump(void);
+
+/*
+ * Description :
+ * Receive and drop one dump frame sent by the other MCU through UART.
+ */
+void PROF_discardFrame(void);
+
+#endif
+
+#endif /* PROFILER_H_ */
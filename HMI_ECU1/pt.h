@@ -0,0 +1,64 @@
+/*
+ * pt.h
+ * Description: Stackless coroutines ( protothreads ) for the UI flows
+ *
+ * A coroutine is a function returning PT_WAITING while it waits and PT_ENDED once it reached its end,
+ * the scheduler calls it again and again and it goes on from its last wait.
+ * Its place is kept in a PT_Type ( 4 bytes ) as the line of the wait, through a switch ( Duff's device ),
+ * so it has no stack of its own:
+ * - its local variables are lost at every wait, what must live across a wait is a static or global variable
+ * - a switch statement must not contain a wait, use if / else inside a coroutine
+ * - a coroutine runs its children with PT_SPAWN on a PT_Type of their own
+ */
+
+#ifndef PT_H_
+#define PT_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef struct
+{
+	uint16 line; /* Line of the last wait, 0 before the first one */
+	uint16 wake; /* End of the current PT_SLEEP */
+}PT_Type;
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Return values of a coroutine */
+#define PT_WAITING                     0
+#define PT_ENDED                       1
+
+/* Declaration of a coroutine: PT_THREAD(name(PT_Type *pt, other arguments)) */
+#define PT_THREAD(name_args)           uint8 name_args
+
+/* Start a coroutine from its beginning at its next call */
+#define PT_INIT(pt)                    ((pt)->line = 0)
+
+/* First and last statements of a coroutine */
+#define PT_BEGIN(pt)                   switch((pt)->line) { case 0:
+#define PT_END(pt)                     } (pt)->line = 0; return PT_ENDED
+
+/* Leave the coroutine before its end, it starts again from the beginning at its next call */
+#define PT_EXIT(pt)                    do{ (pt)->line = 0; return PT_ENDED; }while(0)
+
+/* Wait until the condition is true, it is checked at every call of the coroutine */
+#define PT_WAIT_UNTIL(pt, condition)   do{ (pt)->line = __LINE__; case __LINE__: \
+                                           if(!(condition)) { return PT_WAITING; } }while(0)
+
+/* Give the processor back to the scheduler once */
+#define PT_YIELD(pt)                   do{ (pt)->line = __LINE__; return PT_WAITING; case __LINE__: ; }while(0)
+
+/* Run a child coroutine on its own PT_Type until it ends */
+#define PT_SPAWN(pt, child_pt, thread) do{ PT_INIT(child_pt); PT_WAIT_UNTIL(pt, (thread) == PT_ENDED); }while(0)
+
+/* Wait for a number of ticks of a free running 16 bits clock, up to 32767 ticks */
+#define PT_SLEEP(pt, now, ticks)       do{ (pt)->wake = (uint16)((now) + (ticks)); \
+                                           PT_WAIT_UNTIL(pt, (sint16)((now) - (pt)->wake) >= 0); }while(0)
+
+#endif /* PT_H_ */
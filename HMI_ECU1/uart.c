@@ -66,6 +66,12 @@ uint8 UART_recieveByte(void)
     return UDR;
 }
 
+boolean UART_isByteReceived(void)
+{
+	/* RXC flag is set while unread data is in the Rx buffer (UDR) */
+	return BIT_IS_SET(UCSRA,RXC) ? TRUE : FALSE;
+}
+
 void UART_sendString(const uint8 *Str)
 {
 	uint8 i = 0;
@@ -40,6 +40,11 @@ void UART_sendByte(uint8 data);
  * Function responsible for receiving a byte
  */
 uint8 UART_recieveByte(void);
+/*
+ * Description :
+ * Return TRUE if a received byte is waiting, UART_recieveByte() then returns it without waiting
+ */
+boolean UART_isByteReceived(void);
 /*
  * Description :
  * Function responsible for initialize the uart device
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+door_model.py
+Description: Host kinematics model of the door driven by the CONTROL MCU.
+             It replays the motor ramp of dc_motor.c and the phase logic of
+             CONTROL_openingDoor and compares the door cycle time of the
+             fixed-time sequence with the limit-switch sequence.
+
+Usage: door_model.py [--tau S] [--travel S ...]
+
+The ramp steps, the PWM period and the phase times are read from the
+CONTROL_ECU1 headers so the model follows the firmware configuration.
+The door itself is a first-order model: its speed follows the PWM duty with
+the time constant tau and reaches the full travel in 'travel' seconds at
+100 % duty.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+CONTROL_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "CONTROL_ECU1")
+
+
+def read_defines(*headers):
+    """Return the integer #defines of the required CONTROL_ECU1 headers."""
+    defines = {}
+    for header in headers:
+        with open(os.path.join(CONTROL_DIR, header)) as header_file:
+            for name, value in re.findall(r"^#define\s+(\w+)\s+(\d+)\b", header_file.read(), re.M):
+                defines[name] = int(value)
+    return defines
+
+
+class Door:
+    """Door position (0 closed .. 1 open) driven by the ramped PWM duty."""
+
+    def __init__(self, cfg, travel, tau):
+        self.cfg = cfg
+        self.dt = cfg["PWM_PERIOD_US"] * 1e-6
+        self.full_speed = 1.0 / travel
+        self.tau = tau
+        self.position = 0.0
+        self.speed = 0.0
+        self.duty = 0
+        self.time = 0.0
+
+    def step(self, direction, target_duty):
+        """One PWM period: DcMotor_rampTick then the door dynamics."""
+        if self.duty < target_duty:
+            self.duty = min(self.duty + self.cfg["DcMotor_ACCEL_STEP"], target_duty)
+        elif self.duty > target_duty:
+            self.duty = max(self.duty - self.cfg["DcMotor_DECEL_STEP"], target_duty)
+        wanted = direction * self.full_speed * self.duty / self.cfg["PWM_MAX_DUTY"]
+        self.speed += (wanted - self.speed) * self.dt / self.tau
+        self.position = min(1.0, max(0.0, self.position + self.speed * self.dt))
+        self.time += self.dt
+
+    def stop(self):
+        """DcMotor_Stop: the drive is cut at once."""
+        self.duty = 0
+
+    def run_phase(self, direction, timeout, closed_loop):
+        """Drive until the limit switch ( closed loop ) or the time out, return the phase time."""
+        start = self.time
+        target = self.cfg["PWM_MAX_DUTY"] * self.cfg["DOOR_CRUISE_SPEED"] // 100
+        limit = 1.0 if direction > 0 else 0.0
+        while self.time - start < timeout:
+            if closed_loop and self.position == limit:
+                self.stop()
+                break
+            self.step(direction, target)
+        return self.time - start
+
+    def hold(self, seconds):
+        start = self.time
+        while self.time - start < seconds:
+            self.step(0, 0)
+
+
+def door_cycle(cfg, travel, tau, closed_loop):
+    door = Door(cfg, travel, tau)
+    opening = door.run_phase(+1, cfg["OPEN_DOOR_TIME"], closed_loop)
+    opened = door.position
+    door.hold(cfg["HOLD_DOOR_TIME"])
+    closing = door.run_phase(-1, cfg["CLOSE_DOOR_TIME"], closed_loop)
+    return door.time, opening, closing, opened
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Door cycle time, fixed-time vs limit-switch phases")
+    parser.add_argument("--tau", type=float, default=0.15,
+                        help="time constant of the motor and door in seconds (default 0.15)")
+    parser.add_argument("--travel", type=float, nargs="+", default=[4.0, 6.0, 8.0, 10.0, 12.0, 14.0],
+                        help="door travel time at full speed in seconds")
+    args = parser.parse_args()
+
+    cfg = read_defines("main.h", "dc_motor.h", "pwm.h")
+    for name in ("OPEN_DOOR_TIME", "HOLD_DOOR_TIME", "CLOSE_DOOR_TIME", "DOOR_CRUISE_SPEED",
+                 "DcMotor_ACCEL_STEP", "DcMotor_DECEL_STEP", "PWM_PERIOD_US", "PWM_MAX_DUTY"):
+        if name not in cfg:
+            sys.exit("%s not found in the CONTROL_ECU1 headers" % name)
+
+    print("door cycle, tau = %.2f s, hold = %d s, time outs = %d s / %d s"
+          % (args.tau, cfg["HOLD_DOOR_TIME"], cfg["OPEN_DOOR_TIME"], cfg["CLOSE_DOOR_TIME"]))
+    print("  %-10s %12s %12s %10s %10s %8s" % ("travel [s]", "fixed [s]", "limits [s]", "open [s]", "close [s]", "saved"))
+    for travel in args.travel:
+        fixed, _, _, opened = door_cycle(cfg, travel, args.tau, closed_loop=False)
+        limits, opening, closing, _ = door_cycle(cfg, travel, args.tau, closed_loop=True)
+        note = "" if opened >= 1.0 else "  (door not fully open at the time out)"
+        print("  %-10.1f %12.2f %12.2f %10.2f %10.2f %7.0f%%%s"
+              % (travel, fixed, limits, opening, closing, 100.0 * (fixed - limits) / fixed, note))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,11 @@
+/*
+ * interrupt.h
+ * Description: Host stand-in of <avr/interrupt.h>, the scan runs in the same thread as the reader
+ */
+#ifndef AVR_INTERRUPT_H_
+#define AVR_INTERRUPT_H_
+
+#define cli()
+#define sei()
+
+#endif /* AVR_INTERRUPT_H_ */
@@ -0,0 +1,22 @@
+/*
+ * io.h
+ * Description: Host stand-in of <avr/io.h> for the keypad co-simulation
+ *
+ * The port and direction registers are plain variables of keypad_sim.c and
+ * the pin registers are read through the matrix model, so gpio.h and keypad.c
+ * build on the host without any change.
+ */
+#ifndef AVR_IO_H_
+#define AVR_IO_H_
+
+extern volatile unsigned char SREG;
+
+extern volatile unsigned char PORTA, PORTB, PORTC, PORTD;
+extern volatile unsigned char DDRA, DDRB, DDRC, DDRD;
+extern volatile unsigned char PINA, PINB, PIND;
+
+/* The keypad port, its levels come from the keys closed by the typist */
+unsigned char SIM_readKeypadPins(void);
+#define PINC                           (SIM_readKeypadPins())
+
+#endif /* AVR_IO_H_ */
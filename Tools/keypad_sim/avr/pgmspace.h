@@ -0,0 +1,11 @@
+/*
+ * pgmspace.h
+ * Description: Host stand-in of <avr/pgmspace.h>, the flash tables are plain constants
+ */
+#ifndef AVR_PGMSPACE_H_
+#define AVR_PGMSPACE_H_
+
+#define PROGMEM
+#define pgm_read_byte(address)         (*(const unsigned char *)(address))
+
+#endif /* AVR_PGMSPACE_H_ */
@@ -0,0 +1,270 @@
+/*
+ * keypad_sim.c
+ * Description: Host co-simulation of the HMI keypad scan and its event FIFO
+ *
+ * HMI_ECU1/keypad.c is built for the host against the stand-in AVR headers of this folder.
+ * A scripted typist closes the keys of a matrix model, every contact bounces on its press and
+ * on its release, KEYPAD_scan() runs every KEYPAD_SCAN_PERIOD_MS of simulated time and the
+ * application reads the FIFO only outside a busy window ( LCD, UART or door work ).
+ * Each scenario checks that every keystroke comes out once and in order as a press and a
+ * release, that the long presses are reported, and that KEYPAD_getLostEvents() stays 0.
+ * The last scenario types more than the FIFO holds to check that the lost events are counted.
+ *
+ * Build and run from the repository root:
+ *   gcc -Wall -I Tools/keypad_sim -I HMI_ECU1 -o keypad_sim Tools/keypad_sim/keypad_sim.c HMI_ECU1/keypad.c
+ *   ./keypad_sim
+ */
+#include <stdio.h>
+#include "gpio.h"
+#include "keypad.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+#define SIM_MAX_STROKES                32
+#define SIM_MAX_EVENTS                 128
+#define SIM_BOUNCE_MS                  5     /* the contact chatters for 5 ms after every edge */
+#define SIM_SETTLE_MS                  200   /* run time after the last release, to drain the FIFO */
+#define SIM_LONG_PRESS_MS              (KEYPAD_LONG_PRESS_SCANS * KEYPAD_SCAN_PERIOD_MS)
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef struct
+{
+	uint8 index;   /* key index in the matrix, (col*NUM_OF_ROWS)+row */
+	uint32 down;   /* first contact, in ms */
+	uint32 up;     /* contact opened, in ms */
+}SIM_Stroke;
+
+typedef struct
+{
+	const char *name;
+	const char *keys;     /* typed keys, the digits stand for the keys 0 to 9 */
+	uint16 hold_ms;       /* time every key is held */
+	uint16 period_ms;     /* time between two key presses, below hold_ms the keys roll over */
+	uint16 busy_from_ms;  /* the application reads no key in [busy_from_ms, busy_to_ms) */
+	uint16 busy_to_ms;
+	boolean overflow;     /* more keystrokes than the FIFO holds, lost events are expected */
+}SIM_Scenario;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+volatile uint8 SREG;
+volatile uint8 PORTA, PORTB, PORTC, PORTD;
+volatile uint8 DDRA, DDRB, DDRC, DDRD;
+volatile uint8 PINA, PINB, PIND;
+
+static SIM_Stroke g_strokes[SIM_MAX_STROKES];
+static uint8 g_strokesCount;
+static uint32 g_now;                        /* simulated time, in ms */
+static uint16 g_lfsr = 0xACE1;              /* contact bounce noise */
+static uint8 g_keyIndex[256];               /* key value -> key index, filled by the key map scenario */
+
+static KEYPAD_Event g_events[SIM_MAX_EVENTS];
+static uint8 g_eventsCount;
+
+static const SIM_Scenario g_scenarios[] = {
+	{ "PIN typed ahead during LCD and UART work", "12345=54321=", 40, 70, 0, 900, FALSE },
+	{ "rolled over keys",                         "1234567890",   60, 40, 100, 500, FALSE },
+	{ "long presses",                             "78",           800, 1000, 0, 1500, FALSE },
+	{ "more keys than the FIFO holds",            "12345678901234567890", 40, 70, 0, 1500, TRUE },
+};
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/* One bit of noise from a 16 bits Galois LFSR, the runs are repeatable */
+static uint8 SIM_noise(void)
+{
+	g_lfsr = (g_lfsr >> 1) ^ (-(g_lfsr & 1u) & 0xB400u);
+	return g_lfsr & 1u;
+}
+
+/* Contact state of a key now: closed while held, random during the bounce after every edge */
+static boolean SIM_keyClosed(uint8 index)
+{
+	uint8 i;
+	for(i = 0; i < g_strokesCount; i++)
+	{
+		if(g_strokes[i].index != index)
+		{
+			continue;
+		}
+		if((g_now >= g_strokes[i].down) && (g_now < g_strokes[i].down + SIM_BOUNCE_MS))
+		{
+			return SIM_noise();
+		}
+		if((g_now >= g_strokes[i].up) && (g_now < g_strokes[i].up + SIM_BOUNCE_MS))
+		{
+			return SIM_noise();
+		}
+		if((g_now >= g_strokes[i].down) && (g_now < g_strokes[i].up))
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Levels of the keypad port: the pull-ups hold the rows high, a closed key pulls its row
+ * down when its col is an output driven low.
+ */
+uint8 SIM_readKeypadPins(void)
+{
+	uint8 index, row, col_pin;
+	uint8 pins = PORTC;
+	for(index = 0; index < KEYPAD_NUM_OF_KEYS; index++)
+	{
+		row = index % NUM_OF_ROWS;
+		col_pin = KEYPAD_FIRST_COL_PIN_ID + (index / NUM_OF_ROWS);
+		if(((DDRC >> col_pin) & 1) && !((PORTC >> col_pin) & 1) && SIM_keyClosed(index))
+		{
+			pins &= ~(1 << (KEYPAD_FIRST_ROW_PIN_ID + row));
+		}
+	}
+	return pins;
+}
+
+/*
+ * Run the scan from now until the end time, the application takes the events from the FIFO
+ * at every tick outside the busy window.
+ */
+static void SIM_run(uint32 end, uint32 busy_from, uint32 busy_to)
+{
+	KEYPAD_Event event;
+	for(; g_now < end; g_now += KEYPAD_SCAN_PERIOD_MS)
+	{
+		KEYPAD_scan();
+		if((g_now >= busy_from) && (g_now < busy_to))
+		{
+			continue;
+		}
+		while(KEYPAD_getEvent(&event))
+		{
+			if(g_eventsCount < SIM_MAX_EVENTS)
+			{
+				g_events[g_eventsCount++] = event;
+			}
+		}
+	}
+}
+
+/* Press every key alone and learn which value the keypad module gives it */
+static boolean SIM_mapKeys(void)
+{
+	uint8 index;
+	uint32 start;
+	for(index = 0; index < KEYPAD_NUM_OF_KEYS; index++)
+	{
+		start = g_now;
+		g_strokesCount = 1;
+		g_strokes[0].index = index;
+		g_strokes[0].down = start;
+		g_strokes[0].up = start + 50;
+		g_eventsCount = 0;
+		SIM_run(start + 50 + SIM_SETTLE_MS, 0, 0);
+		if((g_eventsCount != 2) || (g_events[0].type != KEYPAD_PRESS) || (g_events[1].type != KEYPAD_RELEASE)
+				|| (g_events[0].key != g_events[1].key))
+		{
+			printf("key map: key index %u gave %u events -> FAIL\n", index, g_eventsCount);
+			return FALSE;
+		}
+		g_keyIndex[g_events[0].key] = index;
+	}
+	g_strokesCount = 0;
+	printf("key map: %u keys, one press and one release each -> PASS\n", KEYPAD_NUM_OF_KEYS);
+	return TRUE;
+}
+
+/* Key value of a character of a scenario */
+static uint8 SIM_keyValue(char key)
+{
+	return ((key >= '0') && (key <= '9')) ? (uint8)(key - '0') : (uint8)key;
+}
+
+static boolean SIM_runScenario(const SIM_Scenario *scenario)
+{
+	uint8 i;
+	uint8 presses = 0, releases = 0, long_presses = 0, expected_long_presses = 0;
+	boolean in_order = TRUE;
+	uint8 lost_before = KEYPAD_getLostEvents();
+	uint8 lost;
+	uint32 start = g_now;
+	boolean pass;
+
+	g_strokesCount = 0;
+	for(i = 0; scenario->keys[i] != '\0'; i++)
+	{
+		g_strokes[i].index = g_keyIndex[SIM_keyValue(scenario->keys[i])];
+		g_strokes[i].down = start + (uint32)i * scenario->period_ms;
+		g_strokes[i].up = g_strokes[i].down + scenario->hold_ms;
+		g_strokesCount++;
+		if(scenario->hold_ms > SIM_LONG_PRESS_MS)
+		{
+			expected_long_presses++;
+		}
+	}
+
+	g_eventsCount = 0;
+	SIM_run(g_strokes[g_strokesCount - 1].up + SIM_SETTLE_MS,
+			start + scenario->busy_from_ms, start + scenario->busy_to_ms);
+	lost = KEYPAD_getLostEvents() - lost_before;
+
+	/* the keys are all held for the same time, so the releases come in the order of the presses */
+	for(i = 0; i < g_eventsCount; i++)
+	{
+		if(g_events[i].type == KEYPAD_PRESS)
+		{
+			in_order &= (presses < g_strokesCount) && (g_events[i].key == SIM_keyValue(scenario->keys[presses]));
+			presses++;
+		}
+		else if(g_events[i].type == KEYPAD_RELEASE)
+		{
+			in_order &= (releases < presses) && (g_events[i].key == SIM_keyValue(scenario->keys[releases]));
+			releases++;
+		}
+		else
+		{
+			long_presses++;
+		}
+	}
+
+	if(scenario->overflow)
+	{
+		/* what was typed once the FIFO was full is lost, what came out is still in order */
+		pass = in_order && (lost > 0) && (presses < g_strokesCount);
+	}
+	else
+	{
+		pass = in_order && (lost == 0) && (presses == g_strokesCount) && (releases == g_strokesCount)
+				&& (long_presses == expected_long_presses);
+	}
+
+	printf("%s: %u keystrokes, %u presses, %u releases, %u long presses, %u lost events%s -> %s\n",
+			scenario->name, g_strokesCount, presses, releases, long_presses, lost,
+			in_order ? "" : ", out of order", pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+int main(void)
+{
+	uint8 i;
+	boolean pass;
+
+	/* let the scan see the keypad idle first */
+	SIM_run(SIM_SETTLE_MS, 0, 0);
+
+	pass = SIM_mapKeys();
+	for(i = 0; pass && (i < sizeof(g_scenarios) / sizeof(g_scenarios[0])); i++)
+	{
+		pass = SIM_runScenario(&g_scenarios[i]);
+	}
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+prof_report.py
+Description: Host tool that turns the profiler dump frames captured from the
+             UART lines of the HMI and CONTROL MCUs into a per-function
+             latency report.
+
+Usage: prof_report.py [--f-cpu HZ] capture.bin [capture.bin ...]
+
+The capture files hold the raw bytes received on the UART (a serial terminal
+log or a Proteus virtual terminal dump). Every valid frame found is reported,
+the last frame of each MCU is the most recent table.
+
+With the tables of both MCUs, the keypress to door motor start latency is put
+together from its parts: the keypad debounce (fixed by the scan period and the
+debounce scans read from HMI_ECU1/keypad.h), the HMI probe from the debounced
+(=) press to PIN_STREAM_END, the byte on the wire and the CONTROL probe from
+PIN_STREAM_END to the motor start.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_SYNC = b"\xA5\x5A"
+RECORD_SIZE = 10
+
+HMI_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "HMI_ECU1")
+
+# One UART byte at 9600 baud, 8N1: start, 8 data and stop bits
+UART_BYTE_US = 10 * 1e6 / 9600
+
+# Probes of the keypress to door motor start path: (MCU id, probe index)
+KEY_TO_STREAM_END = (ord("H"), 7)
+COMMIT_TO_MOTOR = (ord("C"), 4)
+
+# Probe names in the order of PROF_ProbeId in each MCU's profiler.h
+PROBE_NAMES = {
+    ord("H"): ("HMI", [
+        "LCD_sendCommand",
+        "LCD data write",
+        "KEYPAD scan (full matrix)",
+        "HMI_sendCommand",
+        "HMI_receiveCommand",
+        "LCD_service (tick)",
+        "reset to main menu (0xFFFF: over 65 ms)",
+        "(=) press to PIN_STREAM_END sent",
+    ]),
+    ord("C"): ("CONTROL", [
+        "EEPROM_writeByte",
+        "EEPROM_readByte",
+        "CONTROL_sendCommand",
+        "CONTROL_receiveCommand",
+        "PIN commit to door motor start",
+    ]),
+}
+
+
+def parse_frames(data):
+    """Yield (mcu_id, records) for every frame with a valid checksum."""
+    pos = data.find(FRAME_SYNC)
+    while pos >= 0:
+        header = pos + len(FRAME_SYNC)
+        if header + 2 > len(data):
+            return
+        mcu_id, count = data[header], data[header + 1]
+        end = header + 2 + count * RECORD_SIZE
+        if end < len(data) and (sum(data[header:end]) & 0xFF) == data[end]:
+            records = []
+            for i in range(count):
+                offset = header + 2 + i * RECORD_SIZE
+                records.append(struct.unpack_from("<HIHH", data, offset))
+            yield mcu_id, records
+            pos = data.find(FRAME_SYNC, end + 1)
+        else:
+            pos = data.find(FRAME_SYNC, pos + 1)
+
+
+def print_report(mcu_id, records, f_cpu):
+    mcu_name, names = PROBE_NAMES.get(mcu_id, ("MCU %r" % chr(mcu_id), []))
+    print("%s profile" % mcu_name)
+    print("  %-28s %7s %10s %8s %8s %8s %10s" %
+          ("probe", "calls", "total", "min", "avg", "max", "avg [us]"))
+    for probe, (calls, total, min_cycles, max_cycles) in enumerate(records):
+        name = names[probe] if probe < len(names) else "probe %d" % probe
+        if calls == 0:
+            print("  %-28s %7d %10s %8s %8s %8s %10s" % (name, 0, "-", "-", "-", "-", "-"))
+            continue
+        avg = total / calls
+        print("  %-28s %7d %10d %8d %8.0f %8d %10.1f" %
+              (name, calls, total, min_cycles, avg, max_cycles, avg * 1e6 / f_cpu))
+    print()
+
+
+def read_defines(header):
+    """Return the integer #defines of a HMI_ECU1 header."""
+    with open(os.path.join(HMI_DIR, header)) as header_file:
+        return {name: int(value) for name, value in
+                re.findall(r"^#define\s+(\w+)\s+(\d+)\b", header_file.read(), re.M)}
+
+
+def print_key_to_motor(tables, f_cpu):
+    """Add up the parts of the keypress to door motor start latency, in us."""
+    probes = []
+    for mcu_id, probe in (KEY_TO_STREAM_END, COMMIT_TO_MOTOR):
+        records = tables.get(mcu_id)
+        if records is None or probe >= len(records) or records[probe][0] == 0:
+            return
+        min_cycles, max_cycles = records[probe][2:4]
+        probes.append((min_cycles * 1e6 / f_cpu, max_cycles * 1e6 / f_cpu))
+
+    keypad = read_defines("keypad.h")
+    period_us = keypad["KEYPAD_SCAN_PERIOD_MS"] * 1000.0
+    # The first scan that reads the settled contact comes within one period, then the integrator needs the others
+    debounce = ((keypad["KEYPAD_DEBOUNCE_SCANS"] - 1) * period_us, keypad["KEYPAD_DEBOUNCE_SCANS"] * period_us)
+
+    print("keypress to door motor start [us], from the settled (=) contact")
+    print("  %-36s %10s %10s" % ("part", "min", "max"))
+    print("  %-36s %10.0f %10.0f" % ("keypad debounce (fixed)", debounce[0], debounce[1]))
+    print("  %-36s %10.0f %10.0f" % ("HMI: (=) press to PIN_STREAM_END", probes[0][0], probes[0][1]))
+    print("  %-36s %10.0f %10.0f" % ("PIN_STREAM_END on the wire", UART_BYTE_US, UART_BYTE_US))
+    print("  %-36s %10.0f %10.0f" % ("CONTROL: PIN_STREAM_END to motor", probes[1][0], probes[1][1]))
+    print("  %-36s %10.0f %10.0f" % ("total", debounce[0] + probes[0][0] + UART_BYTE_US + probes[1][0],
+                                      debounce[1] + probes[0][1] + UART_BYTE_US + probes[1][1]))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-function latency report from profiler dumps")
+    parser.add_argument("--f-cpu", type=float, default=1000000.0,
+                        help="CPU clock of the profiled MCU in Hz (default 1 MHz)")
+    parser.add_argument("captures", nargs="+", help="raw UART capture files")
+    args = parser.parse_args()
+
+    tables = {}
+    for capture in args.captures:
+        with open(capture, "rb") as capture_file:
+            data = capture_file.read()
+        for mcu_id, records in parse_frames(data):
+            print_report(mcu_id, records, args.f_cpu)
+            tables[mcu_id] = records
+
+    if not tables:
+        sys.exit("no profiler frame found")
+
+    print_key_to_motor(tables, args.f_cpu)
+
+
+if __name__ == "__main__":
+    main()